@@ -0,0 +1,548 @@
+#pragma once
+#include <algorithm>    // For std::lower_bound, std::rotate, std::max
+#include <atomic>       // For std::atomic
+#include <cstddef>      // For std::size_t
+#include <cstdint>      // For fixed-width integer types
+#include <cstring>      // For std::memcpy
+#include <memory>       // For std::unique_ptr
+#include <string>       // For std::string
+#include <string_view>  // For std::string_view
+#include <utility>      // For std::swap
+#include <vector>       // For std::vector
+
+#include "MantellaDialogueLine.h"
+#include "MantellaNamePool.h"
+
+namespace MantellaDialogueBacklog {
+
+    using FormID = std::uint32_t;
+
+    constexpr std::size_t kDefaultLinesPerActor = 500;
+
+    // Process-wide, so a version is never reused, not even by an actor that was erased and came back
+    inline std::uint64_t NextVersion() {
+        static std::atomic<std::uint64_t> s_version = 0;
+        return s_version.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // -------------------------------------------------------------------------
+    // TextArena:
+    // Monotonic bump allocator for line text. Nothing is freed individually;
+    // the backlog copies its live lines into a fresh arena (Compact) and drops
+    // the old one once most of it is evicted text, Clear() drops it entirely.
+    // -------------------------------------------------------------------------
+    class TextArena {
+    public:
+        static constexpr std::size_t kChunkSize = 64 * 1024;
+
+        std::string_view Store(std::string_view text) {
+            if (text.empty()) return {};
+            if (m_chunks.empty() || m_chunkUsed + text.size() > m_chunkCapacity) NewChunk(text.size());
+            char* dest = m_chunks.back().get() + m_chunkUsed;
+            std::memcpy(dest, text.data(), text.size());
+            m_chunkUsed += text.size();
+            m_bytesUsed += text.size();
+            return {dest, text.size()};
+        }
+
+        void Reset() {
+            m_chunks.clear();
+            m_chunkUsed = m_chunkCapacity = m_bytesUsed = m_bytesReserved = 0;
+        }
+
+        std::size_t BytesUsed() const { return m_bytesUsed; }
+
+        std::size_t BytesReserved() const { return m_bytesReserved; }
+
+    private:
+        void NewChunk(std::size_t minimum) {
+            m_chunkCapacity = std::max(kChunkSize, minimum);
+            m_chunks.push_back(std::make_unique<char[]>(m_chunkCapacity));
+            m_chunkUsed = 0;
+            m_bytesReserved += m_chunkCapacity;
+        }
+
+        std::vector<std::unique_ptr<char[]>> m_chunks;
+        std::size_t m_chunkUsed = 0;
+        std::size_t m_chunkCapacity = 0;
+        std::size_t m_bytesUsed = 0;
+        std::size_t m_bytesReserved = 0;
+    };
+
+    // A stored line. The text points into the backlog's arena and is only valid while the backlog is not modified.
+    struct LineView {
+        std::string_view playerLine;
+        MantellaNamePool::NameId playerName = MantellaNamePool::kEmptyName;
+        std::string_view npcLine;
+        MantellaNamePool::NameId npcName = MantellaNamePool::kEmptyName;
+        float gameTimeHours = 0.0f;
+        std::uint32_t flags = 0;  // Hooks::DialogueLineFlags
+
+        static LineView Of(const Hooks::DialogueLine& line) {
+            return {line.playerLine, line.playerName, line.npcLine, line.npcName, line.gameTimeHours, line.flags};
+        }
+
+        Hooks::DialogueLine ToLine() const {
+            return {std::string(playerLine), playerName, std::string(npcLine), npcName, gameTimeHours, flags};
+        }
+
+        std::size_t TextBytes() const { return playerLine.size() + npcLine.size(); }
+    };
+
+    // -------------------------------------------------------------------------
+    // ActorRing:
+    // Fixed-capacity ring of one actor's lines, oldest first. Slots are only
+    // allocated as lines arrive, so actors with two lines don't pay for 500.
+    // Also keeps the actor's last encoded co-save segment, which every change
+    // to its lines invalidates; saves only re-encode actors that changed.
+    // Every change also gives the ring a new Version(), so a segment encoded
+    // elsewhere (SnapshotEncoder) can tell whether it is still current.
+    // A ring loaded from a co-save starts out encoded: its lines only exist in
+    // the segment until DialogueBacklog decodes them on first use.
+    // -------------------------------------------------------------------------
+    class ActorRing {
+    public:
+        // Parses an encoded segment into views of its text, which point into the segment
+        using SegmentDecoder = void (*)(std::string_view segment, std::vector<LineView>& lines);
+
+        ActorRing(FormID a_formID, std::size_t a_capacity)
+            : m_formID(a_formID), m_capacity(a_capacity), m_version(NextVersion()) {}
+
+        ActorRing(FormID a_formID, std::size_t a_capacity, std::size_t a_lineCount, float a_oldestHours,
+                  float a_newestHours, std::shared_ptr<const std::string> a_segment, SegmentDecoder a_decoder)
+            : m_formID(a_formID),
+              m_capacity(a_capacity),
+              m_encodedCount(a_lineCount),
+              m_encodedOldestHours(a_oldestHours),
+              m_encodedNewestHours(a_newestHours),
+              m_version(NextVersion()),
+              m_segment(std::move(a_segment)),
+              m_decoder(a_decoder) {}
+
+        // Returns the evicted line if the ring was full
+        bool Push(const LineView& line, LineView& evicted) {
+            InvalidateSegment();
+            if (m_count < m_slots.size()) {
+                m_slots[(m_head + m_count) % m_slots.size()] = line;
+                ++m_count;
+                return false;
+            }
+            if (m_slots.size() < m_capacity) {
+                std::rotate(m_slots.begin(), m_slots.begin() + m_head, m_slots.end());
+                m_head = 0;
+                m_slots.push_back(line);
+                ++m_count;
+                return false;
+            }
+            evicted = m_slots[m_head];
+            m_slots[m_head] = line;
+            m_head = (m_head + 1) % m_slots.size();
+            return true;
+        }
+
+        LineView PopOldest() {
+            InvalidateSegment();
+            LineView oldest = m_slots[m_head];
+            m_head = (m_head + 1) % m_slots.size();
+            if (--m_count == 0) m_head = 0;
+            return oldest;
+        }
+
+        // Keeps the newest `capacity` lines, calls `onEvicted(const LineView&)` for the rest.
+        // An encoded ring has to be decoded first if it holds more than `capacity` lines.
+        template <class Callback>
+        void SetCapacity(std::size_t capacity, Callback&& onEvicted) {
+            if (IsEncoded()) {
+                m_capacity = capacity;
+                return;
+            }
+            InvalidateSegment();
+            while (m_count > capacity) onEvicted(PopOldest());
+            std::vector<LineView> lines;
+            lines.reserve(m_count);
+            ForEach([&](const LineView& line) { lines.push_back(line); });
+            m_slots = std::move(lines);
+            m_head = 0;
+            m_capacity = capacity;
+        }
+
+        // Removes the lines `remove(index, const LineView&)` picks, calls `onRemoved(const LineView&)` for each
+        template <class Predicate, class Callback>
+        void RemoveIf(Predicate&& remove, Callback&& onRemoved) {
+            InvalidateSegment();
+            std::vector<LineView> kept;
+            kept.reserve(m_count);
+            for (std::size_t i = 0; i < m_count; ++i) {
+                const auto& line = At(i);
+                if (remove(i, line))
+                    onRemoved(line);
+                else
+                    kept.push_back(line);
+            }
+            m_slots = std::move(kept);
+            m_head = 0;
+            m_count = m_slots.size();
+        }
+
+        const LineView& Oldest() const { return m_slots[m_head]; }
+
+        const LineView& At(std::size_t index) const { return m_slots[(m_head + index) % m_slots.size()]; }
+
+        LineView& At(std::size_t index) { return m_slots[(m_head + index) % m_slots.size()]; }
+
+        template <class Callback>
+        void ForEach(Callback&& callback) const {
+            for (std::size_t i = 0; i < m_count; ++i) callback(At(i));
+        }
+
+        FormID GetFormID() const { return m_formID; }
+
+        std::size_t Size() const { return IsEncoded() ? m_encodedCount : m_count; }
+
+        bool Empty() const { return Size() == 0; }
+
+        // Game time of the oldest / newest line, also while encoded. The ring must not be empty.
+        float OldestHours() const { return IsEncoded() ? m_encodedOldestHours : Oldest().gameTimeHours; }
+
+        float NewestHours() const { return IsEncoded() ? m_encodedNewestHours : At(m_count - 1).gameTimeHours; }
+
+        // The lines are still only in the segment, Oldest/At/ForEach see none of them
+        bool IsEncoded() const { return m_decoder != nullptr; }
+
+        // Decodes the segment into slots, `store(std::string_view)` copies the text to where it will live.
+        // The lines don't change, so the segment and Version() stay.
+        template <class Store>
+        void Decode(Store&& store) {
+            if (!IsEncoded()) return;
+            std::vector<LineView> lines;
+            lines.reserve(m_encodedCount);
+            m_decoder(*m_segment, lines);
+            for (auto& line : lines) {
+                line.playerLine = store(line.playerLine);
+                line.npcLine = store(line.npcLine);
+            }
+            m_slots = std::move(lines);
+            m_head = 0;
+            m_count = m_slots.size();
+            m_encodedCount = 0;
+            m_decoder = nullptr;
+        }
+
+        std::uint64_t Version() const { return m_version; }
+
+        bool HasSegment() const { return m_segment != nullptr; }
+
+        // The cached encoded segment, nullptr if the lines changed since it was encoded
+        std::shared_ptr<const std::string> SegmentPtr() const { return m_segment; }
+
+        // The cached encoded segment, re-encoded with `encode(std::string& out)` first if the lines changed.
+        // The cache is not part of the lines, so saving can fill it in through a const backlog.
+        template <class Encode>
+        const std::string& Segment(Encode&& encode) const {
+            if (!m_segment) {
+                auto segment = std::make_shared<std::string>();
+                encode(*segment);
+                m_segment = std::move(segment);
+            }
+            return *m_segment;
+        }
+
+        // Installs a segment encoded from a copy of the lines, unless they changed again since `version`
+        bool SetSegment(std::shared_ptr<const std::string> segment, std::uint64_t version) const {
+            if (version != m_version) return false;
+            m_segment = std::move(segment);
+            return true;
+        }
+
+        // Forgets the cached segment, the next save encodes the lines again. The ring must be decoded.
+        void InvalidateSegment() {
+            m_segment.reset();
+            m_version = NextVersion();
+        }
+
+    private:
+
+        FormID m_formID;
+        std::size_t m_capacity;
+        std::vector<LineView> m_slots;
+        std::size_t m_head = 0;
+        std::size_t m_count = 0;
+        std::size_t m_encodedCount = 0;
+        float m_encodedOldestHours = 0.0f;
+        float m_encodedNewestHours = 0.0f;
+        std::uint64_t m_version;
+        mutable std::shared_ptr<const std::string> m_segment;
+        SegmentDecoder m_decoder = nullptr;
+    };
+
+    // -------------------------------------------------------------------------
+    // DialogueBacklog:
+    // Captured dialogue that was not sent to Mantella yet, per actor.
+    // - actors live in a vector sorted by FormID (binary search, no node allocations)
+    // - every actor has a bounded ring, a full ring evicts its oldest line
+    // - all text lives in one TextArena; evicted text is reclaimed by Compact()
+    // - actors loaded from a co-save stay encoded until first looked up
+    // Not thread safe, the owner has to synchronize access.
+    // -------------------------------------------------------------------------
+    class DialogueBacklog {
+    public:
+        explicit DialogueBacklog(std::size_t a_linesPerActor = kDefaultLinesPerActor)
+            : m_linesPerActor(std::max<std::size_t>(1, a_linesPerActor)) {}
+
+        void SetLinesPerActor(std::size_t linesPerActor) {
+            linesPerActor = std::max<std::size_t>(1, linesPerActor);
+            if (linesPerActor == m_linesPerActor) return;
+            m_linesPerActor = linesPerActor;
+            for (auto& actor : m_actors) {
+                if (actor.Size() > m_linesPerActor) Decode(actor);
+                actor.SetCapacity(m_linesPerActor, [&](const LineView& line) { OnRemoved(line); });
+            }
+            std::erase_if(m_actors, [](const ActorRing& actor) { return actor.Empty(); });
+            Touch();
+        }
+
+        std::size_t LinesPerActor() const { return m_linesPerActor; }
+
+        // Copies the line's text into the arena. Returns true if an older line of that actor had to be evicted.
+        bool Push(FormID formID, const LineView& line) {
+            Touch();
+            LineView stored = line;
+            stored.playerLine = m_arena.Store(line.playerLine);
+            stored.npcLine = m_arena.Store(line.npcLine);
+            m_liveTextBytes += stored.TextBytes();
+            ++m_lineCount;
+            LineView evicted;
+            const bool didEvict = FindOrInsert(formID).Push(stored, evicted);
+            if (didEvict) OnRemoved(evicted);
+            MaybeCompact();
+            return didEvict;
+        }
+
+        bool Push(FormID formID, const Hooks::DialogueLine& line) { return Push(formID, LineView::Of(line)); }
+
+        // Adds an actor straight from its encoded co-save segment, for loading. Its lines are decoded the first
+        // time they are looked up (Find, Take, Push); until then they only take up the segment's memory.
+        // Returns false if the actor is already in the backlog.
+        bool AdoptEncoded(FormID formID, std::size_t lineCount, float oldestHours, float newestHours,
+                          std::shared_ptr<const std::string> segment, ActorRing::SegmentDecoder decoder) {
+            if (lineCount == 0) return true;
+            auto it = LowerBound(formID);
+            if (it != m_actors.end() && it->GetFormID() == formID) return false;
+            Touch();
+            it = m_actors.emplace(it, formID, m_linesPerActor, lineCount, oldestHours, newestHours, std::move(segment),
+                                  decoder);
+            m_lineCount += lineCount;
+            if (lineCount > m_linesPerActor) {
+                Decode(*it);
+                it->SetCapacity(m_linesPerActor, [&](const LineView& line) { OnRemoved(line); });
+            }
+            return true;
+        }
+
+        bool Contains(FormID formID) const { return Peek(formID) != nullptr; }
+
+        // Decodes the actor first if it is still encoded
+        const ActorRing* Find(FormID formID) {
+            auto it = LowerBound(formID);
+            if (it == m_actors.end() || it->GetFormID() != formID) return nullptr;
+            Decode(*it);
+            return &*it;
+        }
+
+        // Without decoding: of an encoded actor only the FormID, Size, Version and segment are there
+        const ActorRing* Peek(FormID formID) const {
+            auto it = LowerBound(formID);
+            return (it != m_actors.end() && it->GetFormID() == formID) ? &*it : nullptr;
+        }
+
+        // Removes the actor and returns its lines, oldest first
+        std::vector<Hooks::DialogueLine> Take(FormID formID) {
+            std::vector<Hooks::DialogueLine> lines;
+            auto it = LowerBound(formID);
+            if (it == m_actors.end() || it->GetFormID() != formID) return lines;
+            Decode(*it);
+            lines.reserve(it->Size());
+            it->ForEach([&](const LineView& line) { lines.push_back(line.ToLine()); });
+            Erase(it);
+            return lines;
+        }
+
+        // Removes the actor's lines that `remove(index, const LineView&)` picks (index 0 is the oldest line).
+        // Returns how many lines the actor has left.
+        template <class Predicate>
+        std::size_t RemoveLines(FormID formID, Predicate&& remove) {
+            auto it = LowerBound(formID);
+            if (it == m_actors.end() || it->GetFormID() != formID) return 0;
+            Decode(*it);
+            Touch();
+            it->RemoveIf(remove, [&](const LineView& line) { OnRemoved(line); });
+            const auto left = it->Size();
+            if (left == 0) Erase(it);
+            return left;
+        }
+
+        bool Erase(FormID formID) {
+            auto it = LowerBound(formID);
+            if (it == m_actors.end() || it->GetFormID() != formID) return false;
+            Erase(it);
+            return true;
+        }
+
+        // Calls `callback(const ActorRing&)` for every actor, in FormID order. Encoded actors are passed as they are.
+        template <class Callback>
+        void ForEachActor(Callback&& callback) const {
+            for (const auto& actor : m_actors) callback(actor);
+        }
+
+        // Evicts the globally oldest lines (by game time) until at most `maxLines` are left
+        std::size_t TrimToTotal(std::size_t maxLines) {
+            std::size_t evicted = 0;
+            if (m_lineCount > maxLines) DecodeAll();
+            while (m_lineCount > maxLines) {
+                ActorRing* oldest = nullptr;
+                for (auto& actor : m_actors)
+                    if (!oldest || actor.Oldest().gameTimeHours < oldest->Oldest().gameTimeHours) oldest = &actor;
+                OnRemoved(oldest->PopOldest());
+                ++evicted;
+                if (oldest->Empty()) Erase(m_actors.begin() + (oldest - m_actors.data()));
+            }
+            return evicted;
+        }
+
+        struct ExpiryProgress {
+            std::size_t linesExpired = 0;
+            bool done = false;  // reached the last actor
+            FormID next = 0;    // where to continue otherwise
+        };
+
+        // Drops the lines older than `cutoffHours` (game time) of at most `maxActors` actors, starting at the first
+        // actor at or after `from`. Call it again with the returned `next` until `done` to spread a sweep out.
+        // Actors whose lines all expired are erased without being decoded.
+        ExpiryProgress ExpireBefore(float cutoffHours, FormID from, std::size_t maxActors) {
+            ExpiryProgress progress;
+            auto it = LowerBound(from);
+            for (std::size_t visited = 0; it != m_actors.end() && visited < maxActors; ++visited) {
+                if (it->NewestHours() < cutoffHours) {
+                    progress.linesExpired += it->Size();
+                    it = Erase(it);
+                    continue;
+                }
+                if (it->OldestHours() < cutoffHours) {
+                    Decode(*it);
+                    while (it->Oldest().gameTimeHours < cutoffHours) {
+                        OnRemoved(it->PopOldest());
+                        ++progress.linesExpired;
+                    }
+                }
+                ++it;
+            }
+            progress.done = it == m_actors.end();
+            if (!progress.done) progress.next = it->GetFormID();
+            return progress;
+        }
+
+        // Moves all live text into a fresh arena and releases the old one. Invalidates every LineView.
+        void Compact() {
+            TextArena fresh;
+            for (auto& actor : m_actors)
+                for (std::size_t i = 0; !actor.IsEncoded() && i < actor.Size(); ++i) {
+                    auto& line = actor.At(i);
+                    line.playerLine = fresh.Store(line.playerLine);
+                    line.npcLine = fresh.Store(line.npcLine);
+                }
+            std::swap(m_arena, fresh);
+        }
+
+        void DecodeAll() {
+            for (auto& actor : m_actors) Decode(actor);
+        }
+
+        // Drops every cached segment, decoding the actors that only have theirs, so the next save encodes
+        // everything again. The lines don't change, but Version() does.
+        void InvalidateSegments() {
+            for (auto& actor : m_actors) {
+                Decode(actor);
+                actor.InvalidateSegment();
+            }
+            Touch();
+        }
+
+        void Clear() {
+            Touch();
+            m_actors.clear();
+            m_actors.shrink_to_fit();
+            m_arena.Reset();
+            m_lineCount = m_liveTextBytes = 0;
+        }
+
+        std::size_t ActorCount() const { return m_actors.size(); }
+
+        std::size_t LineCount() const { return m_lineCount; }
+
+        bool Empty() const { return m_actors.empty(); }
+
+        std::size_t LiveTextBytes() const { return m_liveTextBytes; }
+
+        // Changes whenever lines are added or removed (not on Compact, which only moves text)
+        std::uint64_t Version() const { return m_version; }
+
+        std::size_t ArenaBytes() const { return m_arena.BytesReserved(); }
+
+    private:
+        // Compact once more than half of the arena is evicted text
+        static constexpr std::size_t kCompactThresholdBytes = 1024 * 1024;
+
+        std::vector<ActorRing>::iterator LowerBound(FormID formID) {
+            return std::lower_bound(m_actors.begin(), m_actors.end(), formID,
+                                    [](const ActorRing& actor, FormID id) { return actor.GetFormID() < id; });
+        }
+
+        std::vector<ActorRing>::const_iterator LowerBound(FormID formID) const {
+            return std::lower_bound(m_actors.begin(), m_actors.end(), formID,
+                                    [](const ActorRing& actor, FormID id) { return actor.GetFormID() < id; });
+        }
+
+        ActorRing& FindOrInsert(FormID formID) {
+            auto it = LowerBound(formID);
+            if (it == m_actors.end() || it->GetFormID() != formID) it = m_actors.emplace(it, formID, m_linesPerActor);
+            Decode(*it);
+            return *it;
+        }
+
+        void Decode(ActorRing& actor) {
+            if (!actor.IsEncoded()) return;
+            actor.Decode([&](std::string_view text) { return m_arena.Store(text); });
+            actor.ForEach([&](const LineView& line) { m_liveTextBytes += line.TextBytes(); });
+        }
+
+        std::vector<ActorRing>::iterator Erase(std::vector<ActorRing>::iterator it) {
+            Touch();
+            if (it->IsEncoded()) m_lineCount -= it->Size();
+            it->ForEach([&](const LineView& line) { OnRemoved(line); });
+            it = m_actors.erase(it);
+            if (m_actors.empty()) m_arena.Reset();
+            return it;
+        }
+
+        void OnRemoved(const LineView& line) {
+            Touch();
+            m_liveTextBytes -= line.TextBytes();
+            --m_lineCount;
+        }
+
+        void Touch() { m_version = NextVersion(); }
+
+        void MaybeCompact() {
+            const auto used = m_arena.BytesUsed();
+            if (used > kCompactThresholdBytes && used > 2 * m_liveTextBytes) Compact();
+        }
+
+        std::size_t m_linesPerActor;
+        std::vector<ActorRing> m_actors;
+        TextArena m_arena;
+        std::size_t m_lineCount = 0;
+        std::size_t m_liveTextBytes = 0;
+        std::uint64_t m_version = NextVersion();
+    };
+
+}
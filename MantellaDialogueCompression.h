@@ -0,0 +1,223 @@
+#pragma once
+#include <algorithm>    // For std::max, std::min
+#include <cstddef>      // For std::size_t
+#include <cstdint>      // For fixed-width integer types
+#include <cstring>      // For std::memcpy
+#include <memory>       // For std::unique_ptr
+#include <mutex>        // For std::mutex
+#include <string>       // For std::string
+#include <string_view>  // For std::string_view
+
+#include <zstd.h>
+
+namespace MantellaDialogueCompression {
+
+    // First u32 of a 'HIS2' v2+ record, telling how the rest of it is stored
+    enum Codec : std::uint32_t {
+        kCodecNone = 0,       // the payload as is
+        kCodecZstdDict1 = 1,  // one zstd frame, compressed with kDictionary below
+    };
+
+    // A record that would decompress to more than this is treated as corrupted
+    constexpr std::size_t kMaxDecompressedBytes = 256 * 1024 * 1024;
+
+    // -------------------------------------------------------------------------
+    // Raw-content dictionary: phrases and names that keep coming back in
+    // vanilla dialogue, picked by hand rather than trained with ZDICT. zstd
+    // uses it as history in front of every record, so even a short backlog
+    // finds matches from its first byte. The most common text is at the end,
+    // closest to the data. Changing a single byte breaks reading older
+    // co-saves, a new (or trained) dictionary needs a new Codec instead.
+    // -------------------------------------------------------------------------
+    constexpr std::string_view kDictionary =
+        "Windhelm Riften Solitude Markarth Falkreath Morthal Dawnstar Winterhold Riverwood Rorikstead Ivarstead "
+        "Dragon Bridge Helgen High Hrothgar Blackreach Sovngarde Solstheim Raven Rock Cyrodiil Hammerfell Morrowind "
+        "Imperial Legion Stormcloaks Ulfric Stormcloak General Tullius Thalmor Aldmeri Dominion Greybeards Blades "
+        "Dark Brotherhood Thieves Guild Companions College of Winterhold Jorrvaskr Dragonsreach Dwemer Falmer "
+        "Daedra Daedric Prince Azura Molag Bal Sheogorath Hircine Mehrunes Dagon Akatosh Arkay Dibella Julianos "
+        "Kynareth Mara Stendarr Talos Zenithar Shor Alduin Paarthurnax Miraak Dovahkiin Dragonborn Thu'um Shout "
+        "Nord Breton Redguard Imperial Altmer Bosmer Dunmer Orsimer Argonian Khajiit skooma septims gold coin "
+        "Jarl steward housecarl court wizard bandit draugr vampire werewolf necromancer giant mammoth sabre cat "
+        "troll spriggan hagraven forsworn dragon priest barrow ruin cave mine fort shrine temple tomb crypt "
+        "I used to be an adventurer like you. Then I took an arrow in the knee. "
+        "Let me guess... someone stole your sweetroll? "
+        "Do you get to the Cloud District very often? Oh, what am I saying, of course you don't. "
+        "No lollygaggin'. Watch the skies, traveler. Citizen. Stay out of trouble. "
+        "What do you need? What is it? What do you want? Can I help you? Need something? "
+        "Is there something I can do for you? Anything else? Let me know if you need anything. "
+        "Hello there. Greetings. Well met. Good day to you. Welcome, friend. Ah, a customer! "
+        "Farewell. Safe travels. See you later. Walk with the gods. Talos guide you. Be careful out there. "
+        "I've got nothing to say to you. Leave me alone. Go away. Keep your hands to yourself. "
+        "I don't know what you're talking about. I haven't heard anything about that. "
+        "Have you heard the news? They say there's a dragon. The war is going badly. "
+        "Skyrim belongs to the Nords! The Empire is the only thing holding Tamriel together. "
+        "Stormcloak rebels Imperial soldiers civil war "
+        "Take a look, I have the finest wares in all of Skyrim. Looking to buy or sell? "
+        "I'll need some time to think about it. That's not something I can help you with. "
+        "Thank you, thank you so much! I won't forget this. You have my gratitude. "
+        "Please, you have to help me. I need your help. Can you help me with something? "
+        "What can you tell me about this place? Tell me about yourself. Any news? Any rumors? "
+        "Where can I find the Jarl? What's the matter? What happened here? Who are you? "
+        "Follow me. Wait here. Let's go. Lead the way. I'll follow you. I'm with you. "
+        "I don't think so. Maybe later. I'm not interested. Very well. As you wish. Of course. "
+        "Yes. No. Hmm? What? Huh? Ah. Oh. Well... I see. Right. Indeed. "
+        "you the and to of a I it is that in this what for me have be not your my with on we can "
+        "do know will they are there here if but all just about so was he she them him her "
+        "don't can't won't I'm you're it's that's there's I'll I've we'll they're what's ";
+
+    namespace detail {
+        struct CCtxDeleter {
+            void operator()(ZSTD_CCtx* cctx) const { ZSTD_freeCCtx(cctx); }
+        };
+        struct DCtxDeleter {
+            void operator()(ZSTD_DCtx* dctx) const { ZSTD_freeDCtx(dctx); }
+        };
+
+        // Digesting the dictionary is the expensive part of a small compression, so it is done once per level
+        inline const ZSTD_CDict* CompressionDictionary(int level) {
+            static std::mutex lock;
+            static ZSTD_CDict* dictionary = nullptr;
+            static int dictionaryLevel = 0;
+            std::scoped_lock guard(lock);
+            if (!dictionary || dictionaryLevel != level) {
+                // The previous one is kept alive: a save on another thread may still use it
+                dictionary = ZSTD_createCDict(kDictionary.data(), kDictionary.size(), level);
+                dictionaryLevel = level;
+            }
+            return dictionary;
+        }
+
+        inline const ZSTD_DDict* DecompressionDictionary() {
+            static ZSTD_DDict* dictionary = ZSTD_createDDict(kDictionary.data(), kDictionary.size());
+            return dictionary;
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // CompressingRecord:
+    // Stands in for the serialization interface and compresses whatever is
+    // written to it into a zstd frame, which it streams on to `a_intfc`
+    // behind a kCodecZstdDict1 header. Call Finish() once everything has been
+    // written. Works with anything that has SKSE's
+    // `bool WriteRecordData(const void*, std::uint32_t)`.
+    // -------------------------------------------------------------------------
+    template <class Intfc>
+    class CompressingRecord {
+    public:
+        static constexpr std::size_t kOutputSize = 64 * 1024;
+
+        CompressingRecord(Intfc* a_intfc, int level) : m_intfc(a_intfc), m_cctx(ZSTD_createCCtx()) {
+            const std::uint32_t codec = kCodecZstdDict1;
+            const auto* dictionary = detail::CompressionDictionary(level);
+            // The checksum lets a damaged co-save fail to load instead of decoding into garbage
+            m_ok = m_cctx && dictionary && !ZSTD_isError(ZSTD_CCtx_refCDict(m_cctx.get(), dictionary)) &&
+                   !ZSTD_isError(ZSTD_CCtx_setParameter(m_cctx.get(), ZSTD_c_checksumFlag, 1)) &&
+                   m_intfc->WriteRecordData(&codec, sizeof(codec));
+            m_output.resize(kOutputSize);
+            m_bytesOut = sizeof(codec);
+        }
+
+        bool WriteRecordData(const void* data, std::uint32_t size) {
+            m_bytesIn += size;
+            return Compress(data, size, ZSTD_e_continue);
+        }
+
+        // Ends the frame and writes out what is left of it
+        bool Finish() { return Compress(nullptr, 0, ZSTD_e_end); }
+
+        std::size_t BytesIn() const { return m_bytesIn; }
+
+        std::size_t BytesOut() const { return m_bytesOut; }
+
+    private:
+        bool Compress(const void* data, std::size_t size, ZSTD_EndDirective mode) {
+            if (!m_ok) return false;
+            ZSTD_inBuffer input{data, size, 0};
+            std::size_t remaining = 0;
+            do {
+                ZSTD_outBuffer output{m_output.data(), m_output.size(), 0};
+                remaining = ZSTD_compressStream2(m_cctx.get(), &output, &input, mode);
+                if (ZSTD_isError(remaining)) return m_ok = false;
+                if (output.pos > 0) {
+                    if (!m_intfc->WriteRecordData(m_output.data(), static_cast<std::uint32_t>(output.pos)))
+                        return m_ok = false;
+                    m_bytesOut += output.pos;
+                }
+            } while (mode == ZSTD_e_end ? remaining != 0 : input.pos < input.size);
+            return true;
+        }
+
+        Intfc* m_intfc;
+        std::unique_ptr<ZSTD_CCtx, detail::CCtxDeleter> m_cctx;
+        std::string m_output;
+        std::size_t m_bytesIn = 0;
+        std::size_t m_bytesOut = 0;
+        bool m_ok = false;
+    };
+
+    // Starts an uncompressed v2+ record, CompressingRecord writes its own header
+    template <class Intfc>
+    bool WriteUncompressedHeader(Intfc* a_intfc) {
+        const std::uint32_t codec = kCodecNone;
+        return a_intfc->WriteRecordData(&codec, sizeof(codec));
+    }
+
+    // Collects record data in memory, to compress ahead of a save or for tests
+    struct StringRecord {
+        std::string data;
+
+        bool WriteRecordData(const void* bytes, std::uint32_t size) {
+            data.append(static_cast<const char*>(bytes), size);
+            return true;
+        }
+    };
+
+    // Decodes a kCodecZstdDict1 frame (without the codec header). False if it is corrupted or too large.
+    inline bool Decompress(std::string_view frame, std::string& out) {
+        std::unique_ptr<ZSTD_DCtx, detail::DCtxDeleter> dctx(ZSTD_createDCtx());
+        const auto* dictionary = detail::DecompressionDictionary();
+        if (!dctx || !dictionary || ZSTD_isError(ZSTD_DCtx_refDDict(dctx.get(), dictionary))) return false;
+
+        // Streamed frames do not always carry their size, dialogue text usually shrinks to a quarter
+        const auto contentSize = ZSTD_getFrameContentSize(frame.data(), frame.size());
+        out.clear();
+        if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize != ZSTD_CONTENTSIZE_ERROR &&
+            contentSize <= kMaxDecompressedBytes)
+            out.resize(static_cast<std::size_t>(contentSize));
+        else
+            out.resize(std::max<std::size_t>(frame.size() * 4, ZSTD_DStreamOutSize()));
+
+        ZSTD_inBuffer input{frame.data(), frame.size(), 0};
+        std::size_t written = 0;
+        while (true) {
+            ZSTD_outBuffer output{out.data() + written, out.size() - written, 0};
+            const auto result = ZSTD_decompressStream(dctx.get(), &output, &input);
+            if (ZSTD_isError(result)) return false;
+            written += output.pos;
+            if (result == 0) break;  // frame complete
+            if (input.pos == input.size && output.pos < output.size) return false;  // cut off
+            if (written == out.size()) {
+                if (out.size() >= kMaxDecompressedBytes) return false;
+                out.resize(std::min(out.size() * 2, kMaxDecompressedBytes));
+            }
+        }
+        out.resize(written);
+        return input.pos == input.size;
+    }
+
+    // Splits a 'HIS2' v2+ record into its payload, decompressing into `scratch` if needed
+    inline bool DecodeRecord(std::string_view record, std::string& scratch, std::string_view& payload) {
+        std::uint32_t codec = 0;
+        if (record.size() < sizeof(codec)) return false;
+        std::memcpy(&codec, record.data(), sizeof(codec));
+        record.remove_prefix(sizeof(codec));
+        if (codec == kCodecNone) {
+            payload = record;
+            return true;
+        }
+        if (codec != kCodecZstdDict1 || !Decompress(record, scratch)) return false;
+        payload = scratch;
+        return true;
+    }
+
+}
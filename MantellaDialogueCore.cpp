@@ -0,0 +1,23 @@
+// -----------------------------------------------------------------------------
+// MantellaDialogueCore:
+// The parts of the plugin that do not touch the game. They are header-only and
+// compiled straight into plugin.cpp; this translation unit builds them on
+// their own for the offline benchmarks (MANTELLA_BUILD_BENCHMARKS), which also
+// catches headers that only compile thanks to something plugin.cpp included first.
+// -----------------------------------------------------------------------------
+#include "MantellaDialogueBacklog.h"
+#include "MantellaDialogueCompression.h"
+#include "MantellaDialogueDedup.h"
+#include "MantellaDialogueFilter.h"
+#include "MantellaDialogueFormat.h"
+#include "MantellaDialogueIniConfig.h"
+#include "MantellaDialogueJournal.h"
+#include "MantellaDialogueLine.h"
+#include "MantellaDialogueQueue.h"
+#include "MantellaDialogueRules.h"
+#include "MantellaDialogueSerialization.h"
+#include "MantellaDialogueSnapshot.h"
+#include "MantellaDialogueStats.h"
+#include "MantellaDialogueText.h"
+#include "MantellaHttpChannel.h"
+#include "MantellaNamePool.h"
@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>    // For std::find
+#include <cstddef>      // For std::size_t
+#include <cstdint>      // For fixed-width integer types
+#include <cstring>      // For std::memcpy
+#include <mutex>        // For std::mutex
+#include <string_view>  // For std::string_view
+#include <vector>       // For std::vector
+
+namespace MantellaDialogueDedup {
+
+    // -------------------------------------------------------------------------
+    // XXH64 (https://github.com/Cyan4973/xxHash), the reference algorithm.
+    // Only used to recognize events we already sent and lines the verdict
+    // cache has seen, never persisted.
+    // -------------------------------------------------------------------------
+    namespace detail {
+        constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+        constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ull;
+        constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+        constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+        constexpr std::uint64_t RotateLeft(std::uint64_t value, int bits) {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        inline std::uint64_t Read64(const unsigned char* p) {
+            std::uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        inline std::uint32_t Read32(const unsigned char* p) {
+            std::uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        constexpr std::uint64_t Round(std::uint64_t acc, std::uint64_t input) {
+            return RotateLeft(acc + input * kPrime2, 31) * kPrime1;
+        }
+
+        constexpr std::uint64_t MergeRound(std::uint64_t acc, std::uint64_t value) {
+            return (acc ^ Round(0, value)) * kPrime1 + kPrime4;
+        }
+    }
+
+    inline std::uint64_t Hash(std::string_view text, std::uint64_t seed = 0) {
+        using namespace detail;
+        const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+        const auto* const end = p + text.size();
+        std::uint64_t hash;
+        if (text.size() >= 32) {
+            std::uint64_t v1 = seed + kPrime1 + kPrime2, v2 = seed + kPrime2, v3 = seed, v4 = seed - kPrime1;
+            for (; p + 32 <= end; p += 32) {
+                v1 = Round(v1, Read64(p));
+                v2 = Round(v2, Read64(p + 8));
+                v3 = Round(v3, Read64(p + 16));
+                v4 = Round(v4, Read64(p + 24));
+            }
+            hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+            hash = MergeRound(hash, v1);
+            hash = MergeRound(hash, v2);
+            hash = MergeRound(hash, v3);
+            hash = MergeRound(hash, v4);
+        } else {
+            hash = seed + kPrime5;
+        }
+        hash += text.size();
+        for (; p + 8 <= end; p += 8) hash = RotateLeft(hash ^ Round(0, Read64(p)), 27) * kPrime1 + kPrime4;
+        if (p + 4 <= end) {
+            hash = RotateLeft(hash ^ (static_cast<std::uint64_t>(Read32(p)) * kPrime1), 23) * kPrime2 + kPrime3;
+            p += 4;
+        }
+        for (; p < end; ++p) hash = RotateLeft(hash ^ (*p * kPrime5), 11) * kPrime1;
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    // -------------------------------------------------------------------------
+    // DedupWindow:
+    // Remembers the hashes of the last N events, so a repeat of any of them is
+    // caught even when other speakers were sent in between. Size 0 disables it.
+    // -------------------------------------------------------------------------
+    class DedupWindow {
+    public:
+        explicit DedupWindow(std::size_t a_size = 16) { Resize(a_size); }
+
+        void Resize(std::size_t size) {
+            std::scoped_lock lock(m_lock);
+            m_hashes.assign(size, 0);
+            m_used = 0;
+            m_next = 0;
+        }
+
+        // Returns true if `text` is one of the last N events, otherwise records it
+        bool CheckAndRecord(std::string_view text) {
+            const auto hash = Hash(text);
+            std::scoped_lock lock(m_lock);
+            if (m_hashes.empty()) return false;
+            const auto end = m_hashes.begin() + static_cast<std::ptrdiff_t>(m_used);
+            if (std::find(m_hashes.begin(), end, hash) != end) {
+                ++m_skipped;
+                return true;
+            }
+            m_hashes[m_next] = hash;
+            m_next = (m_next + 1) % m_hashes.size();
+            if (m_used < m_hashes.size()) ++m_used;
+            return false;
+        }
+
+        std::uint64_t SkippedCount() const {
+            std::scoped_lock lock(m_lock);
+            return m_skipped;
+        }
+
+    private:
+        mutable std::mutex m_lock;
+        std::vector<std::uint64_t> m_hashes;
+        std::size_t m_used = 0;
+        std::size_t m_next = 0;
+        std::uint64_t m_skipped = 0;
+    };
+
+}
@@ -0,0 +1,258 @@
+#pragma once
+#include <algorithm>      // For std::lower_bound, std::fill
+#include <cstddef>        // For std::size_t
+#include <cstdint>        // For fixed-width integer types
+#include <deque>          // For std::deque
+#include <string>         // For std::string
+#include <string_view>    // For std::string_view
+#include <unordered_set>  // For std::unordered_set
+#include <utility>        // For std::pair
+#include <vector>         // For std::vector
+
+namespace MantellaDialogueFilter {
+
+    // ASCII-only case folding; dialogue blacklists are plain English lines
+    inline unsigned char FoldCase(unsigned char c, bool caseInsensitive) {
+        return (caseInsensitive && c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+    }
+
+    // -------------------------------------------------------------------------
+    // Transparent hash / equality so the exact-match set can be probed with a
+    // std::string_view without building a std::string first.
+    // -------------------------------------------------------------------------
+    struct StringHash {
+        using is_transparent = void;
+        bool caseInsensitive = false;
+
+        std::size_t operator()(std::string_view s) const {
+            std::uint64_t hash = 14695981039346656037ull;  // FNV-1a
+            for (unsigned char c : s) hash = (hash ^ FoldCase(c, caseInsensitive)) * 1099511628211ull;
+            return static_cast<std::size_t>(hash);
+        }
+    };
+
+    struct StringEqual {
+        using is_transparent = void;
+        bool caseInsensitive = false;
+
+        bool operator()(std::string_view a, std::string_view b) const {
+            if (a.size() != b.size()) return false;
+            for (std::size_t i = 0; i < a.size(); ++i)
+                if (FoldCase(a[i], caseInsensitive) != FoldCase(b[i], caseInsensitive)) return false;
+            return true;
+        }
+    };
+
+    // -------------------------------------------------------------------------
+    // CompiledFilter:
+    // Built once from a blacklist. Entries without '*' are exact matches and go
+    // into a hash set. Entries with '*' are wildcard rules ("Stage1*", "*(Remove
+    // from Mantella conversation)", "I want*to*"); "\*" is a literal '*' in
+    // either kind of entry. All literal segments of the wildcard rules are
+    // compiled into one Aho-Corasick automaton. A single pass of the automaton
+    // over a line tells which segments occur, and only the rules whose segments
+    // all occurred are verified against their anchors.
+    // -------------------------------------------------------------------------
+    class CompiledFilter {
+    public:
+        CompiledFilter() = default;
+
+        static CompiledFilter Compile(const std::vector<std::string>& rules, bool caseInsensitive) {
+            CompiledFilter filter;
+            filter.m_caseInsensitive = caseInsensitive;
+            filter.m_exact = ExactSet(rules.size(), StringHash{caseInsensitive}, StringEqual{caseInsensitive});
+            for (const auto& rule : rules) {
+                if (rule.empty()) continue;
+                auto parts = SplitAtWildcards(rule);
+                if (parts.size() == 1) {
+                    filter.m_exact.insert(std::move(parts.front()));
+                    continue;
+                }
+                filter.AddWildcardRule(parts);
+            }
+            filter.BuildFailureLinks();
+            return filter;
+        }
+
+        bool Matches(std::string_view text) const {
+            if (!m_exact.empty() && m_exact.find(text) != m_exact.end()) return true;
+            if (m_matchesEverything) return true;
+            if (m_rules.empty()) return false;
+
+            // One automaton pass, stamping every segment that occurs somewhere in the text
+            thread_local std::vector<std::uint32_t> seen;
+            thread_local std::uint32_t stamp = 0;
+            if (seen.size() < m_segments.size()) seen.resize(m_segments.size(), 0);
+            if (++stamp == 0) {
+                std::fill(seen.begin(), seen.end(), 0);
+                stamp = 1;
+            }
+            std::uint32_t state = 0;
+            for (unsigned char c : text) {
+                state = Step(state, FoldCase(c, m_caseInsensitive));
+                for (auto segment : m_nodes[state].outputs) seen[segment] = stamp;
+            }
+
+            for (const auto& rule : m_rules) {
+                bool candidate = true;
+                for (auto segment : rule.segments)
+                    if (seen[segment] != stamp) {
+                        candidate = false;
+                        break;
+                    }
+                if (candidate && Verify(rule, text)) return true;
+            }
+            return false;
+        }
+
+        bool Empty() const { return m_exact.empty() && m_rules.empty() && !m_matchesEverything; }
+
+        std::size_t RuleCount() const { return m_exact.size() + m_rules.size() + (m_matchesEverything ? 1 : 0); }
+
+    private:
+        using ExactSet = std::unordered_set<std::string, StringHash, StringEqual>;
+
+        struct Node {
+            std::vector<std::pair<unsigned char, std::uint32_t>> edges;  // sorted by character
+            std::uint32_t fail = 0;
+            std::vector<std::uint32_t> outputs;  // segment ids ending here (including via failure links)
+        };
+
+        struct WildcardRule {
+            std::vector<std::uint32_t> segments;  // in pattern order, may repeat
+            bool anchoredStart = false;
+            bool anchoredEnd = false;
+        };
+
+        static const std::uint32_t* FindEdge(const Node& node, unsigned char c) {
+            auto it = std::lower_bound(node.edges.begin(), node.edges.end(), c,
+                                       [](const auto& edge, unsigned char value) { return edge.first < value; });
+            return (it != node.edges.end() && it->first == c) ? &it->second : nullptr;
+        }
+
+        std::uint32_t Step(std::uint32_t state, unsigned char c) const {
+            while (true) {
+                if (auto next = FindEdge(m_nodes[state], c)) return *next;
+                if (state == 0) return 0;
+                state = m_nodes[state].fail;
+            }
+        }
+
+        std::uint32_t InternSegment(std::string_view segment) {
+            for (std::uint32_t i = 0; i < m_segments.size(); ++i)
+                if (StringEqual{m_caseInsensitive}(m_segments[i], segment)) return i;
+            auto id = static_cast<std::uint32_t>(m_segments.size());
+            m_segments.emplace_back(segment);
+            std::uint32_t state = 0;
+            for (unsigned char raw : segment) {
+                auto c = FoldCase(raw, m_caseInsensitive);
+                if (auto next = FindEdge(m_nodes[state], c)) {
+                    state = *next;
+                    continue;
+                }
+                auto child = static_cast<std::uint32_t>(m_nodes.size());
+                auto& edges = m_nodes[state].edges;
+                edges.insert(std::lower_bound(edges.begin(), edges.end(), std::make_pair(c, std::uint32_t{0})),
+                             {c, child});
+                m_nodes.emplace_back();
+                state = child;
+            }
+            m_nodes[state].outputs.push_back(id);
+            return id;
+        }
+
+        // The text between the unescaped '*' of a rule, with "\*" turned into '*'. Any other backslash is kept
+        // as it is. A rule without a wildcard comes back as a single part.
+        static std::vector<std::string> SplitAtWildcards(std::string_view rule) {
+            std::vector<std::string> parts(1);
+            for (std::size_t i = 0; i < rule.size(); ++i) {
+                if (rule[i] == '\\' && i + 1 < rule.size() && rule[i + 1] == '*')
+                    parts.back().push_back(rule[++i]);
+                else if (rule[i] == '*')
+                    parts.emplace_back();
+                else
+                    parts.back().push_back(rule[i]);
+            }
+            return parts;
+        }
+
+        // `parts` as split by SplitAtWildcards, an empty first / last part is a leading / trailing '*'
+        void AddWildcardRule(const std::vector<std::string>& parts) {
+            WildcardRule rule;
+            rule.anchoredStart = !parts.front().empty();
+            rule.anchoredEnd = !parts.back().empty();
+            for (const auto& part : parts)
+                if (!part.empty()) rule.segments.push_back(InternSegment(part));
+            if (rule.segments.empty()) {
+                m_matchesEverything = true;  // pattern was only '*'
+                return;
+            }
+            m_rules.push_back(std::move(rule));
+        }
+
+        void BuildFailureLinks() {
+            std::deque<std::uint32_t> queue;
+            for (const auto& [c, child] : m_nodes[0].edges) queue.push_back(child);
+            while (!queue.empty()) {
+                auto current = queue.front();
+                queue.pop_front();
+                for (const auto& [c, child] : m_nodes[current].edges) {
+                    auto fail = m_nodes[current].fail;
+                    std::uint32_t target = 0;
+                    while (true) {
+                        if (auto next = FindEdge(m_nodes[fail], c); next && *next != child) {
+                            target = *next;
+                            break;
+                        }
+                        if (fail == 0) break;
+                        fail = m_nodes[fail].fail;
+                    }
+                    m_nodes[child].fail = target;
+                    const auto& inherited = m_nodes[target].outputs;
+                    m_nodes[child].outputs.insert(m_nodes[child].outputs.end(), inherited.begin(), inherited.end());
+                    queue.push_back(child);
+                }
+            }
+        }
+
+        std::size_t Find(std::string_view text, std::string_view segment, std::size_t from) const {
+            if (segment.size() > text.size()) return std::string_view::npos;
+            StringEqual equal{m_caseInsensitive};
+            for (std::size_t i = from; i + segment.size() <= text.size(); ++i)
+                if (equal(text.substr(i, segment.size()), segment)) return i;
+            return std::string_view::npos;
+        }
+
+        // Segments must appear in order, the first/last one pinned to the start/end if the rule is anchored there
+        bool Verify(const WildcardRule& rule, std::string_view text) const {
+            StringEqual equal{m_caseInsensitive};
+            std::size_t pos = 0;
+            for (std::size_t i = 0; i < rule.segments.size(); ++i) {
+                std::string_view segment = m_segments[rule.segments[i]];
+                const bool first = i == 0;
+                const bool last = i + 1 == rule.segments.size();
+                if (last && rule.anchoredEnd) {
+                    if (text.size() < pos + segment.size()) return false;
+                    return equal(text.substr(text.size() - segment.size()), segment);
+                }
+                if (first && rule.anchoredStart) {
+                    if (text.size() < segment.size() || !equal(text.substr(0, segment.size()), segment)) return false;
+                    pos = segment.size();
+                    continue;
+                }
+                auto found = Find(text, segment, pos);
+                if (found == std::string_view::npos) return false;
+                pos = found + segment.size();
+            }
+            return true;
+        }
+
+        bool m_caseInsensitive = false;
+        bool m_matchesEverything = false;
+        ExactSet m_exact{0, StringHash{}, StringEqual{}};
+        std::vector<std::string> m_segments;
+        std::vector<Node> m_nodes{1};
+        std::vector<WildcardRule> m_rules;
+    };
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>      // For std::stable_partition
+#include <cstddef>        // For std::size_t
+#include <cstdint>        // For fixed-width integer types
+#include <functional>     // For std::hash
+#include <string>         // For std::string
+#include <string_view>    // For std::string_view
+#include <unordered_map>  // For std::unordered_map
+#include <utility>        // For std::pair
+#include <vector>         // For std::vector
+
+#include "MantellaDialogueBacklog.h"
+#include "MantellaDialogueLine.h"
+#include "MantellaNamePool.h"
+
+namespace MantellaDialogueFormat {
+
+    // -------------------------------------------------------------------------
+    // Builders for the text we send as Mantella events. Every formatter first
+    // computes the exact output size, reserves once and appends in place, so a
+    // replay of N lines costs one allocation instead of several per line.
+    // Works with anything that has playerLine/playerName/npcLine/npcName
+    // (Hooks::DialogueLine and MantellaDialogueBacklog::LineView).
+    // -------------------------------------------------------------------------
+
+    // "<player>: <playerLine><separator><npc>: <npcLine>"
+    template <class Line>
+    std::size_t ExchangeSize(const Line& line, std::string_view separator) {
+        return MantellaNamePool::Get(line.playerName).size() + 2 + line.playerLine.size() + separator.size() +
+               MantellaNamePool::Get(line.npcName).size() + 2 + line.npcLine.size();
+    }
+
+    template <class Line>
+    void AppendExchange(std::string& out, const Line& line, std::string_view separator) {
+        out.append(MantellaNamePool::Get(line.playerName)).append(": ").append(line.playerLine);
+        out.append(separator);
+        out.append(MantellaNamePool::Get(line.npcName)).append(": ").append(line.npcLine);
+    }
+
+    // A single live exchange: "Player: line; NPC: line"
+    template <class Line>
+    std::string FormatExchange(const Line& line) {
+        std::string out;
+        out.reserve(ExchangeSize(line, "; "));
+        AppendExchange(out, line, "; ");
+        return out;
+    }
+
+    // A replayed backlog: "Player: line;\n NPC: line Player: line;\n NPC: line"
+    inline std::string FormatReplay(const MantellaDialogueBacklog::ActorRing& lines) {
+        using MantellaDialogueBacklog::LineView;
+        constexpr std::string_view kSeparator = ";\n ";
+        std::size_t size = lines.Empty() ? 0 : lines.Size() - 1;  // spaces between exchanges
+        lines.ForEach([&](const LineView& line) { size += ExchangeSize(line, kSeparator); });
+        std::string out;
+        out.reserve(size);
+        lines.ForEach([&](const LineView& line) {
+            if (!out.empty()) out.push_back(' ');
+            AppendExchange(out, line, kSeparator);
+        });
+        return out;
+    }
+
+    // What a budgeted replay does with each line of the backlog
+    enum class ReplayChoice : std::uint8_t {
+        Keep,       // over the budget, stays in the backlog for a later conversation
+        Send,       // part of this replay
+        Duplicate,  // the same exchange happened again later, dropped
+    };
+
+    namespace detail {
+        using ExchangeKey = std::pair<std::string_view, std::string_view>;  // playerLine, npcLine
+
+        struct ExchangeKeyHash {
+            std::size_t operator()(const ExchangeKey& key) const {
+                return std::hash<std::string_view>{}(key.first) * 31 + std::hash<std::string_view>{}(key.second);
+            }
+        };
+    }
+
+    // -------------------------------------------------------------------------
+    // Picks the lines of a replay that may be at most `budget` characters long.
+    // Every exchange counts once, at its most recent occurrence. Lines of
+    // say-once topics come first, as the NPC won't repeat them, then the
+    // rest, newest first. A repeated exchange is say-once if any occurrence
+    // is. The ranking is sent up to the first line that does not fit
+    // anymore, but at least one line. Indexed like ActorRing::At().
+    // -------------------------------------------------------------------------
+    inline std::vector<ReplayChoice> SelectReplay(const MantellaDialogueBacklog::ActorRing& lines,
+                                                  std::size_t budget) {
+        constexpr std::string_view kSeparator = ";\n ";
+        std::vector<ReplayChoice> choices(lines.Size(), ReplayChoice::Keep);
+        std::vector<bool> sayOnce(lines.Size(), false);
+        std::vector<std::size_t> ranking;
+        ranking.reserve(lines.Size());
+
+        // exchange -> index of its most recent occurrence
+        std::unordered_map<detail::ExchangeKey, std::size_t, detail::ExchangeKeyHash> seen;
+        seen.reserve(lines.Size());
+        for (std::size_t i = lines.Size(); i-- > 0;) {
+            const auto& line = lines.At(i);
+            const auto [it, inserted] = seen.try_emplace({line.playerLine, line.npcLine}, i);
+            if (line.flags & Hooks::kLineSayOnce) sayOnce[it->second] = true;
+            if (!inserted) {
+                choices[i] = ReplayChoice::Duplicate;
+                continue;
+            }
+            ranking.push_back(i);
+        }
+        std::stable_partition(ranking.begin(), ranking.end(), [&](std::size_t i) { return sayOnce[i]; });
+
+        std::size_t used = 0;
+        for (const auto i : ranking) {
+            const auto size = ExchangeSize(lines.At(i), kSeparator) + 1;
+            if (used > 0 && used + size > budget) break;
+            used += size;
+            choices[i] = ReplayChoice::Send;
+        }
+        return choices;
+    }
+
+    // FormatReplay() of only the lines SelectReplay() chose to send, oldest first
+    inline std::string FormatReplay(const MantellaDialogueBacklog::ActorRing& lines,
+                                    const std::vector<ReplayChoice>& choices) {
+        constexpr std::string_view kSeparator = ";\n ";
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < lines.Size(); ++i)
+            if (choices[i] == ReplayChoice::Send) size += ExchangeSize(lines.At(i), kSeparator) + 1;
+        std::string out;
+        out.reserve(size);
+        for (std::size_t i = 0; i < lines.Size(); ++i) {
+            if (choices[i] != ReplayChoice::Send) continue;
+            if (!out.empty()) out.push_back(' ');
+            AppendExchange(out, lines.At(i), kSeparator);
+        }
+        return out;
+    }
+
+}
@@ -1,11 +1,25 @@
+#pragma once
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <sstream>
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#if defined(_WIN32)
+    #include <Windows.h>
+#endif
+
+#include "MantellaDialogueFilter.h"
+#include "MantellaDialogueText.h"
 #include "ini.h"
 #include "logger.h"
 
@@ -17,36 +31,46 @@ namespace MantellaDialogueIniConfig {
         int FilterShortRepliesMinWordCount;
         bool FilterNonUniqueGreetings;
         bool DebugLogVanillaDialogue;
+        spdlog::level::level_enum LogLevel;
         std::vector<std::string> NPCLineBlacklist;
         std::vector<std::string> PlayerLineBlacklist;
         std::vector<std::string> NPCNamesToIgnore;
-    };
+        bool CaseInsensitiveBlacklists;
+        int MaxDialogueLinesPerActor;
+        int DialogueExpiryHours;
+        int ReplayBudgetChars;
+        int DedupWindowSize;
+        bool EnableHotPathProfiling;
+        int HotPathProfilingIntervalSeconds;
+        bool HotPathProfilingCsv;
+        bool EnableTraceCapture;
+        int TraceCaptureMaxMB;
+        bool CompressDialogueHistory;
+        int DialogueHistoryCompressionLevel;
+        bool EnableHttpSideChannel;
+        std::string HttpSideChannelPath;
+        int StatsLogIntervalMinutes;
 
-    // Global configuration variable
-    Configuration config;
+        // Compiled from the lists above by compileFilters(), this is what the hook matches against
+        MantellaDialogueFilter::CompiledFilter NPCLineFilter;
+        MantellaDialogueFilter::CompiledFilter PlayerLineFilter;
+        MantellaDialogueFilter::CompiledFilter NPCNameFilter;
 
-    // Utility function to trim whitespace from a string
-    static std::string trim(const std::string& str) {
-        const char* whitespace = " \t\n\r";
-        size_t start = str.find_first_not_of(whitespace);
-        if (start == std::string::npos) return "";
-        size_t end = str.find_last_not_of(whitespace);
-        return str.substr(start, end - start + 1);
-    }
+        // Different for every loaded configuration, caches of filter results compare against it
+        std::uint32_t generation = 0;
+    };
 
-    // Utility function to split a string by a delimiter **without** trimming
-    static std::vector<std::string> split(const std::string& s, char delimiter) {
-        std::vector<std::string> tokens;
-        std::istringstream tokenStream(s);
-        std::string token;
-        while (std::getline(tokenStream, token, delimiter)) tokens.push_back(token);
-        return tokens;
-    }
+    // The current configuration. It is never changed in place: a reload builds a new one and swaps it in, so a
+    // reader sees one consistent configuration for as long as it holds on to it and never waits for a reload.
+    inline std::atomic<std::shared_ptr<const Configuration>> s_config;
+
+    inline std::shared_ptr<const Configuration> current() { return s_config.load(std::memory_order_acquire); }
 
     // Utility function to split a string by a delimiter **and** trim each value
-    static std::vector<std::string> splitAndTrim(const std::string& s, char delimiter) {
-        std::vector<std::string> tokens = split(s, delimiter);
-        for (auto& token : tokens) token = trim(token);
+    static std::vector<std::string> splitAndTrim(std::string_view s, char delimiter) {
+        std::vector<std::string> tokens;
+        MantellaDialogueText::ForEachToken(
+            s, delimiter, [&](std::string_view token) { tokens.emplace_back(MantellaDialogueText::Trim(token)); });
         return tokens;
     }
 
@@ -67,6 +91,41 @@ namespace MantellaDialogueIniConfig {
             config->FilterNonUniqueGreetings = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
         else if (strcmp(name, "DebugLogVanillaDialogue") == 0)
             config->DebugLogVanillaDialogue = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+        else if (strcmp(name, "LogLevel") == 0) {
+            // from_str() answers "off" for anything it does not know, keep the default then
+            auto level = spdlog::level::from_str(std::string(MantellaDialogueText::Trim(value)));
+            if (level != spdlog::level::off || strcmp(value, "off") == 0) config->LogLevel = level;
+        }
+        else if (strcmp(name, "MaxDialogueLinesPerActor") == 0)
+            config->MaxDialogueLinesPerActor = std::max(1, atoi(value));
+        else if (strcmp(name, "DialogueExpiryHours") == 0)
+            config->DialogueExpiryHours = std::max(0, atoi(value));
+        else if (strcmp(name, "ReplayBudgetChars") == 0)
+            config->ReplayBudgetChars = std::max(0, atoi(value));
+        else if (strcmp(name, "DedupWindowSize") == 0)
+            config->DedupWindowSize = std::max(0, atoi(value));
+        else if (strcmp(name, "EnableHotPathProfiling") == 0)
+            config->EnableHotPathProfiling = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+        else if (strcmp(name, "HotPathProfilingIntervalSeconds") == 0)
+            config->HotPathProfilingIntervalSeconds = std::max(1, atoi(value));
+        else if (strcmp(name, "HotPathProfilingCsv") == 0)
+            config->HotPathProfilingCsv = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+        else if (strcmp(name, "EnableTraceCapture") == 0)
+            config->EnableTraceCapture = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+        else if (strcmp(name, "TraceCaptureMaxMB") == 0)
+            config->TraceCaptureMaxMB = std::max(4, atoi(value));
+        else if (strcmp(name, "CompressDialogueHistory") == 0)
+            config->CompressDialogueHistory = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+        else if (strcmp(name, "DialogueHistoryCompressionLevel") == 0)
+            config->DialogueHistoryCompressionLevel = std::clamp(atoi(value), 1, 19);
+        else if (strcmp(name, "EnableHttpSideChannel") == 0)
+            config->EnableHttpSideChannel = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+        else if (strcmp(name, "HttpSideChannelPath") == 0 && value[0] == '/')
+            config->HttpSideChannelPath = value;
+        else if (strcmp(name, "StatsLogIntervalMinutes") == 0)
+            config->StatsLogIntervalMinutes = std::max(0, atoi(value));
+        else if (strcmp(name, "CaseInsensitiveBlacklists") == 0)
+            config->CaseInsensitiveBlacklists = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
         else if (strcmp(name, "NPCLineBlacklist") == 0) {
             auto tokens = splitAndTrim(value, ';');
             if (!tokens.empty()) config->NPCLineBlacklist = tokens;
@@ -81,27 +140,164 @@ namespace MantellaDialogueIniConfig {
         return 1;
     }
 
-    // Function to load configuration from an INI file, falling back to defaults
-    void loadConfiguration() {
-        // Set default values
+    // Builds the hashed / wildcard filters from the raw blacklists
+    static void compileFilters(Configuration& config) {
+        config.NPCLineFilter =
+            MantellaDialogueFilter::CompiledFilter::Compile(config.NPCLineBlacklist, config.CaseInsensitiveBlacklists);
+        config.PlayerLineFilter = MantellaDialogueFilter::CompiledFilter::Compile(config.PlayerLineBlacklist,
+                                                                                 config.CaseInsensitiveBlacklists);
+        config.NPCNameFilter =
+            MantellaDialogueFilter::CompiledFilter::Compile(config.NPCNamesToIgnore, config.CaseInsensitiveBlacklists);
+    }
+
+    // DebugLogVanillaDialogue lowers the configured LogLevel to at least debug
+    inline spdlog::level::level_enum effectiveLogLevel(const Configuration& config) {
+        return config.DebugLogVanillaDialogue ? std::min(config.LogLevel, spdlog::level::debug) : config.LogLevel;
+    }
+
+    // zstd level for the dialogue history co-save record, 0 when it is stored uncompressed
+    inline int historyCompressionLevel(const Configuration& config) {
+        return config.CompressDialogueHistory ? config.DialogueHistoryCompressionLevel : 0;
+    }
+
+    constexpr const char* kDefaultPath = "Data/SKSE/Plugins/MantellaDialogue.ini";
+
+    static void setDefaults(Configuration& config) {
         config.FilterShortReplies = true;
         config.FilterShortRepliesMinWordCount = 4;
         config.FilterNonUniqueGreetings = true;
         config.DebugLogVanillaDialogue = false;
+        config.LogLevel = spdlog::level::info;
         config.NPCLineBlacklist = {"Can I help you?", "Farewell", "See you later"};
         config.PlayerLineBlacklist = {"Stage1Hello", "I want you to..", "Goodbye. (Remove from Mantella conversation)"};
         config.NPCNamesToIgnore = {};
+        config.CaseInsensitiveBlacklists = false;
+        config.MaxDialogueLinesPerActor = 500;
+        config.DialogueExpiryHours = 0;
+        config.ReplayBudgetChars = 0;
+        config.DedupWindowSize = 16;
+        config.EnableHotPathProfiling = false;
+        config.HotPathProfilingIntervalSeconds = 60;
+        config.HotPathProfilingCsv = false;
+        config.EnableTraceCapture = false;
+        config.TraceCaptureMaxMB = 256;
+        config.CompressDialogueHistory = true;
+        config.DialogueHistoryCompressionLevel = 3;
+        config.EnableHttpSideChannel = false;
+        config.HttpSideChannelPath = "/vanilla_dialogue";
+        config.StatsLogIntervalMinutes = 10;
+    }
 
-        const std::string filename = "Data/SKSE/Plugins/MantellaDialogue.ini";
-        std::ifstream infile(filename);
-        if (!infile.good()) {
-            logger::error("Failed to open INI file: {}", filename);
-            return;
-        }
+    // Parses an INI file into a new configuration, on top of the defaults. nullptr if the file can't be opened.
+    inline std::shared_ptr<Configuration> parseConfiguration(const std::string& filename) {
+        // Read in one go and parsed from memory, the file is opened only once
+        std::ifstream infile(filename, std::ios::binary | std::ios::ate);
+        if (!infile.good()) return nullptr;
+        std::string text(static_cast<std::size_t>(std::max<std::streamoff>(0, infile.tellg())), '\0');
+        infile.seekg(0);
+        if (!infile.read(text.data(), static_cast<std::streamsize>(text.size()))) return nullptr;
         infile.close();
 
-        IniConfigHelper helper{&config};
-        ini_parse(filename.c_str(), handler, &helper);
+        auto parsed = std::make_shared<Configuration>();
+        setDefaults(*parsed);
+        IniConfigHelper helper{parsed.get()};
+        ini_parse_string(text.c_str(), handler, &helper);
+        compileFilters(*parsed);
+        return parsed;
+    }
+
+    // Makes `loaded` the current configuration
+    inline void publish(std::shared_ptr<Configuration> loaded) {
+        static std::atomic<std::uint32_t> generations = 0;
+        loaded->generation = generations.fetch_add(1, std::memory_order_relaxed) + 1;
+        s_config.store(std::move(loaded), std::memory_order_release);
+    }
+
+    // Function to load configuration from an INI file, falling back to defaults
+    inline void loadConfiguration(const std::string& filename = kDefaultPath) {
+        auto loaded = parseConfiguration(filename);
+        if (!loaded) {
+            logger::error("Failed to open INI file: {}", filename);
+            loaded = std::make_shared<Configuration>();
+            setDefaults(*loaded);
+            compileFilters(*loaded);
+        }
+        publish(std::move(loaded));
     }
 
+#if defined(_WIN32)
+    // -------------------------------------------------------------------------
+    // ConfigWatcher:
+    // Watches the INI's folder with ReadDirectoryChangesW. When the INI was
+    // written to, it is parsed again on the watcher thread and the result is
+    // handed to the callback, which is expected to publish() it. Editors
+    // often save in several steps (write, or delete and rename), so a change
+    // settles for kSettleTime before the file is read, and a file that
+    // can't be opened right then keeps the current configuration.
+    // -------------------------------------------------------------------------
+    class ConfigWatcher {
+    public:
+        static constexpr auto kSettleTime = std::chrono::milliseconds(250);
+        using ReloadCallback = std::function<void(std::shared_ptr<Configuration>)>;
+
+        ConfigWatcher() = default;
+        ConfigWatcher(const ConfigWatcher&) = delete;
+        ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+        // The watcher thread is detached and runs until the process exits, so the watcher has to outlive it
+        bool Start(const std::string& filename, ReloadCallback onReload) {
+            if (m_directory != INVALID_HANDLE_VALUE) return true;
+            m_filename = filename;
+            m_onReload = std::move(onReload);
+            const auto path = std::filesystem::path(filename);
+            m_name = path.filename().wstring();
+            m_directory = CreateFileW(path.parent_path().c_str(), FILE_LIST_DIRECTORY,
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                      FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+            if (m_directory == INVALID_HANDLE_VALUE) return false;
+            std::thread([this]() { Run(); }).detach();
+            return true;
+        }
+
+    private:
+        void Run() {
+            alignas(DWORD) char buffer[16 * 1024];
+            while (true) {
+                DWORD bytes = 0;
+                if (!ReadDirectoryChangesW(m_directory, buffer, sizeof(buffer), FALSE,
+                                           FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME |
+                                               FILE_NOTIFY_CHANGE_SIZE,
+                                           &bytes, nullptr, nullptr)) {
+                    logger::error("ConfigWatcher: Stopped watching {}, error {}", m_filename, GetLastError());
+                    return;
+                }
+                // No bytes: more changed than fit into the buffer, the INI may have been one of them
+                if (bytes > 0 && !MentionsFile(buffer)) continue;
+                std::this_thread::sleep_for(kSettleTime);
+                if (auto reloaded = parseConfiguration(m_filename))
+                    m_onReload(std::move(reloaded));
+                else
+                    logger::warn("ConfigWatcher: Could not open {}, keeping the current configuration", m_filename);
+            }
+        }
+
+        bool MentionsFile(const char* buffer) const {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer);
+            while (true) {
+                if (CompareStringOrdinal(info->FileName, static_cast<int>(info->FileNameLength / sizeof(WCHAR)),
+                                         m_name.c_str(), static_cast<int>(m_name.size()), TRUE) == CSTR_EQUAL)
+                    return true;
+                if (info->NextEntryOffset == 0) return false;
+                info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(reinterpret_cast<const char*>(info) +
+                                                                        info->NextEntryOffset);
+            }
+        }
+
+        std::string m_filename;
+        std::wstring m_name;
+        ReloadCallback m_onReload;
+        HANDLE m_directory = INVALID_HANDLE_VALUE;
+    };
+#endif
+
 }  // namespace MantellaDialogueIniConfig
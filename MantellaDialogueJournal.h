@@ -0,0 +1,271 @@
+#pragma once
+#include <algorithm>    // For std::max, std::min
+#include <chrono>       // For std::chrono::steady_clock
+#include <cstddef>      // For std::size_t
+#include <cstdint>      // For fixed-width integer types
+#include <cstring>      // For std::memcpy
+#include <filesystem>   // For std::filesystem::path
+#include <fstream>      // For std::ifstream
+#include <iterator>     // For std::istreambuf_iterator
+#include <string>       // For std::string
+#include <string_view>  // For std::string_view
+#include <vector>       // For std::vector
+
+#if defined(_WIN32)
+    #include <Windows.h>
+#endif
+
+namespace MantellaDialogueJournal {
+
+    // -------------------------------------------------------------------------
+    // Trace capture journal: every subtitle the hook sees, raw, for replaying
+    // in the benchmarks. Layout (all integers little endian):
+    //   header = u32 magic 'MTJR', u32 version, u32 headerBytes
+    //   record = u32 recordBytes (0 ends the journal), u32 speakerFormID,
+    //            u16 topicInfoFlags, u16 recordFlags, f32 gameTimeHours,
+    //            string speakerName, string subtitle, string topicText,
+    //            u32 responseCount, responseCount x string response
+    //   string = u32 length, length x UTF-8 bytes
+    // The file is pre-sized and mapped, so the unwritten tail is zeros; a
+    // journal of a session that crashed still reads up to the last record.
+    // -------------------------------------------------------------------------
+    constexpr std::uint32_t kMagic = 0x524A544D;  // "MTJR" in file order
+    constexpr std::uint32_t kVersion = 1;
+    constexpr std::uint32_t kHeaderBytes = 12;
+
+    // recordFlags
+    constexpr std::uint16_t kHasTopicInfo = 1 << 0;
+
+    // RE::TOPIC_INFO_DATA::TOPIC_INFO_FLAGS::kSayOnce, the journal stores the game's flags as they are
+    constexpr std::uint16_t kTopicInfoSayOnce = 1 << 2;
+
+    struct Event {
+        std::uint32_t speakerFormID = 0;
+        std::uint16_t topicInfoFlags = 0;
+        std::uint16_t recordFlags = 0;
+        float gameTimeHours = 0.0f;
+        std::string_view speakerName;
+        std::string_view subtitle;
+        std::string_view topicText;
+        std::vector<std::string_view> responses;
+    };
+
+    // Encoded size of one record
+    inline std::size_t RecordSize(const Event& event) {
+        std::size_t size = 4 + 4 + 2 + 2 + 4 + 4 + event.speakerName.size() + 4 + event.subtitle.size() + 4 +
+                           event.topicText.size() + 4;
+        for (auto response : event.responses) size += 4 + response.size();
+        return size;
+    }
+
+    // -------------------------------------------------------------------------
+    // Reading (portable, used by the benchmarks):
+    // Calls `callback(const Event&)` for every complete record in `data`.
+    // Returns false if the header is wrong or a record is cut off / corrupted.
+    // -------------------------------------------------------------------------
+    template <class Callback>
+    bool ForEachEvent(std::string_view data, Callback&& callback) {
+        std::size_t pos = 0;
+        auto readRaw = [&](void* out, std::size_t size) {
+            if (data.size() - pos < size) return false;
+            std::memcpy(out, data.data() + pos, size);
+            pos += size;
+            return true;
+        };
+        auto readString = [&](std::string_view& out) {
+            std::uint32_t length = 0;
+            if (!readRaw(&length, sizeof(length)) || data.size() - pos < length) return false;
+            out = data.substr(pos, length);
+            pos += length;
+            return true;
+        };
+
+        std::uint32_t magic = 0, version = 0, headerBytes = 0;
+        if (!readRaw(&magic, 4) || !readRaw(&version, 4) || !readRaw(&headerBytes, 4) || magic != kMagic ||
+            version > kVersion || headerBytes < kHeaderBytes || headerBytes > data.size())
+            return false;
+        pos = headerBytes;
+
+        Event event;
+        while (data.size() - pos >= 4) {
+            const auto recordStart = pos;
+            std::uint32_t recordBytes = 0, responseCount = 0;
+            readRaw(&recordBytes, 4);
+            if (recordBytes == 0) return true;
+            if (recordBytes > data.size() - recordStart) return false;
+            if (!readRaw(&event.speakerFormID, 4) || !readRaw(&event.topicInfoFlags, 2) ||
+                !readRaw(&event.recordFlags, 2) || !readRaw(&event.gameTimeHours, 4) ||
+                !readString(event.speakerName) || !readString(event.subtitle) || !readString(event.topicText) ||
+                !readRaw(&responseCount, 4) || responseCount > recordBytes / 4)
+                return false;
+            event.responses.resize(responseCount);
+            for (auto& response : event.responses)
+                if (!readString(response)) return false;
+            if (pos != recordStart + recordBytes) return false;
+            callback(event);
+        }
+        return true;
+    }
+
+    inline std::string ReadFile(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    inline bool IsJournal(std::string_view data) {
+        std::uint32_t magic = 0;
+        if (data.size() < sizeof(magic)) return false;
+        std::memcpy(&magic, data.data(), sizeof(magic));
+        return magic == kMagic;
+    }
+
+#if defined(_WIN32)
+    // -------------------------------------------------------------------------
+    // JournalWriter:
+    // Appends records straight into a mapped view of the journal file, no
+    // intermediate buffer and no WriteFile per event. The mapping grows by
+    // doubling up to `maxBytes`, after which capturing stops. Dirty pages are
+    // handed to the OS with FlushViewOfFile every kFlushBytes / kFlushInterval.
+    // Only the ShowSubtitle hook (main thread) writes, so it does no locking.
+    // -------------------------------------------------------------------------
+    class JournalWriter {
+    public:
+        static constexpr std::size_t kInitialBytes = 4 * 1024 * 1024;
+        static constexpr std::size_t kFlushBytes = 1024 * 1024;
+        static constexpr auto kFlushInterval = std::chrono::seconds(5);
+
+        JournalWriter() = default;
+        JournalWriter(const JournalWriter&) = delete;
+        JournalWriter& operator=(const JournalWriter&) = delete;
+
+        ~JournalWriter() { Close(); }
+
+        bool Open(const std::filesystem::path& path, std::size_t maxBytes) {
+            Close();
+            m_maxBytes = std::max(maxBytes, kInitialBytes);
+            m_file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) return false;
+            if (!Map(kInitialBytes)) {
+                Close();
+                return false;
+            }
+            const std::uint32_t header[] = {kMagic, kVersion, kHeaderBytes};
+            std::memcpy(m_view, header, sizeof(header));
+            m_pos = m_flushedPos = kHeaderBytes;
+            m_lastFlush = std::chrono::steady_clock::now();
+            return true;
+        }
+
+        bool IsOpen() const { return m_view != nullptr; }
+
+        // False once the journal could not grow any further, it is closed then
+        bool Append(const Event& event) {
+            if (!m_view) return false;
+            const auto size = RecordSize(event);
+            // Keep 4 zero bytes behind the last record, they end the journal for the reader
+            if (m_pos + size + 4 > m_capacity && !Grow(m_pos + size + 4)) {
+                Close();
+                return false;
+            }
+            char* out = m_view + m_pos;
+            auto put = [&](const void* data, std::size_t length) {
+                std::memcpy(out, data, length);
+                out += length;
+            };
+            auto putString = [&](std::string_view text) {
+                const auto length = static_cast<std::uint32_t>(text.size());
+                put(&length, 4);
+                put(text.data(), text.size());
+            };
+            const auto recordBytes = static_cast<std::uint32_t>(size);
+            const auto responseCount = static_cast<std::uint32_t>(event.responses.size());
+            put(&recordBytes, 4);
+            put(&event.speakerFormID, 4);
+            put(&event.topicInfoFlags, 2);
+            put(&event.recordFlags, 2);
+            put(&event.gameTimeHours, 4);
+            putString(event.speakerName);
+            putString(event.subtitle);
+            putString(event.topicText);
+            put(&responseCount, 4);
+            for (auto response : event.responses) putString(response);
+            m_pos += size;
+            ++m_events;
+            MaybeFlush();
+            return true;
+        }
+
+        // Flushes, cuts the file down to what was written and releases it
+        void Close() {
+            if (m_view) {
+                FlushViewOfFile(m_view, 0);
+                UnmapViewOfFile(m_view);
+                m_view = nullptr;
+            }
+            if (m_mapping) {
+                CloseHandle(m_mapping);
+                m_mapping = nullptr;
+            }
+            if (m_file != INVALID_HANDLE_VALUE) {
+                LARGE_INTEGER end;
+                end.QuadPart = static_cast<LONGLONG>(m_pos + 4);
+                if (m_pos > 0 && SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN)) SetEndOfFile(m_file);
+                CloseHandle(m_file);
+                m_file = INVALID_HANDLE_VALUE;
+            }
+            m_capacity = m_pos = m_flushedPos = 0;
+        }
+
+        std::size_t BytesWritten() const { return m_pos; }
+
+        std::size_t EventCount() const { return m_events; }
+
+    private:
+        bool Map(std::size_t capacity) {
+            const auto size = static_cast<std::uint64_t>(capacity);
+            m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                           static_cast<DWORD>(size & 0xFFFFFFFF), nullptr);
+            if (!m_mapping) return false;
+            m_view = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, capacity));
+            if (!m_view) return false;
+            m_capacity = capacity;
+            return true;
+        }
+
+        bool Grow(std::size_t needed) {
+            if (needed > m_maxBytes) return false;
+            auto capacity = m_capacity;
+            while (capacity < needed) capacity *= 2;
+            capacity = std::min(capacity, m_maxBytes);  // the last step uses all of TraceCaptureMaxMB
+            FlushViewOfFile(m_view, 0);
+            UnmapViewOfFile(m_view);
+            CloseHandle(m_mapping);
+            m_view = nullptr;
+            m_mapping = nullptr;
+            return Map(capacity);
+        }
+
+        void MaybeFlush() {
+            const auto now = std::chrono::steady_clock::now();
+            if (m_pos - m_flushedPos < kFlushBytes && now - m_lastFlush < kFlushInterval) return;
+            // Only the pages written since the last flush
+            const auto pageStart = m_flushedPos & ~static_cast<std::size_t>(4095);
+            FlushViewOfFile(m_view + pageStart, m_pos - pageStart);
+            m_flushedPos = m_pos;
+            m_lastFlush = now;
+        }
+
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+        char* m_view = nullptr;
+        std::size_t m_capacity = 0;
+        std::size_t m_maxBytes = 0;
+        std::size_t m_pos = 0;
+        std::size_t m_flushedPos = 0;
+        std::size_t m_events = 0;
+        std::chrono::steady_clock::time_point m_lastFlush{};
+    };
+#endif
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>  // For fixed-width integer types
+#include <string>   // For std::string
+
+#include "MantellaNamePool.h"
+#include "json.h"  // Include nlohmann/json library
+
+namespace Hooks {
+
+    // DialogueLine::flags
+    enum DialogueLineFlags : std::uint32_t {
+        kLineSayOnce = 1 << 0,  // the topic info is flagged kSayOnce, the NPC won't say it again
+    };
+
+    // -------------------------------------------------------------------------
+    // A small POD struct to store a single exchange: player's line, NPC's line,
+    // and the Skyrim in-game time at which it was recorded.
+    // Names are interned in MantellaNamePool, use MantellaNamePool::Get() to read them.
+    // -------------------------------------------------------------------------
+    struct DialogueLine {
+        std::string playerLine;
+        MantellaNamePool::NameId playerName = MantellaNamePool::kEmptyName;
+        std::string npcLine;
+        MantellaNamePool::NameId npcName = MantellaNamePool::kEmptyName;
+        float gameTimeHours;
+        std::uint32_t flags = 0;  // DialogueLineFlags
+    };
+
+    inline void to_json(nlohmann::json& j, const DialogueLine& line) {
+        j = nlohmann::json{{"playerName", MantellaNamePool::Get(line.playerName)},
+                           {"playerQuery", line.playerLine},
+                           {"npcName", MantellaNamePool::Get(line.npcName)},
+                           {"npcResponse", line.npcLine},
+                           {"gameTimeHours", line.gameTimeHours}};
+    }
+
+    inline void from_json(const nlohmann::json& j, DialogueLine& line) {
+        line.playerName = MantellaNamePool::Intern(j.at("playerName").get<std::string>());
+        j.at("playerQuery").get_to(line.playerLine);
+        line.npcName = MantellaNamePool::Intern(j.at("npcName").get<std::string>());
+        j.at("npcResponse").get_to(line.npcLine);
+        j.at("gameTimeHours").get_to(line.gameTimeHours);
+    }
+
+}
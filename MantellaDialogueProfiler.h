@@ -0,0 +1,243 @@
+#pragma once
+#include <array>        // For std::array
+#include <atomic>       // For std::atomic
+#include <bit>          // For std::bit_width
+#include <chrono>       // For std::chrono::steady_clock
+#include <cstddef>      // For std::size_t
+#include <cstdint>      // For fixed-width integer types
+#include <ctime>        // For std::time
+#include <filesystem>   // For std::filesystem::path
+#include <format>       // For std::format
+#include <fstream>      // For std::ofstream
+#include <functional>   // For std::function
+#include <mutex>        // For std::mutex
+#include <string>       // For std::string
+#include <string_view>  // For std::string_view
+
+#if defined(_WIN32)
+    #include <Windows.h>
+#endif
+
+// Set to 0 (MANTELLA_ENABLE_PROFILING=OFF in CMake) to compile every probe out of the hook.
+#ifndef MANTELLA_ENABLE_PROFILING
+    #define MANTELLA_ENABLE_PROFILING 1
+#endif
+
+namespace MantellaDialogueProfiler {
+
+    // Stages of ShowSubtitle::thunk, in the order they run
+    enum class Stage : std::size_t { Original, IsEnabled, BuildLine, Filter, Dispatch, Total, kCount };
+
+    constexpr std::array<std::string_view, static_cast<std::size_t>(Stage::kCount)> kStageNames{
+        "Original", "IsEnabled", "BuildLine", "Filter", "Dispatch", "Total"};
+
+    // -------------------------------------------------------------------------
+    // High resolution clock: QueryPerformanceCounter on Windows, steady_clock
+    // elsewhere (the offline benchmarks). Stored as ticks, converted when dumped.
+    // -------------------------------------------------------------------------
+    inline std::int64_t Now() {
+#if defined(_WIN32)
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart;
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    inline double NanosecondsPerTick() {
+#if defined(_WIN32)
+        static const double nsPerTick = [] {
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+            return 1e9 / static_cast<double>(frequency.QuadPart);
+        }();
+        return nsPerTick;
+#else
+        return 1e9 * std::chrono::steady_clock::period::num / std::chrono::steady_clock::period::den;
+#endif
+    }
+
+    // -------------------------------------------------------------------------
+    // Histogram:
+    // HDR-style log-linear histogram over 64-bit tick counts. Values below
+    // 2^kSubBucketBits get their own bucket, above that every power of two is
+    // split into 2^kSubBucketBits buckets (~6% relative error). Recording is a
+    // single relaxed fetch_add, so the hook never takes a lock.
+    // -------------------------------------------------------------------------
+    class Histogram {
+    public:
+        static constexpr unsigned kSubBucketBits = 4;
+        static constexpr std::size_t kSubBuckets = std::size_t{1} << kSubBucketBits;
+        static constexpr std::size_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+        static constexpr std::size_t BucketIndex(std::uint64_t value) {
+            const auto msb = static_cast<unsigned>(std::bit_width(value));
+            if (msb <= kSubBucketBits) return static_cast<std::size_t>(value);
+            const auto shift = msb - 1 - kSubBucketBits;
+            return (shift + 1) * kSubBuckets + static_cast<std::size_t>((value >> shift) - kSubBuckets);
+        }
+
+        // Smallest value that lands in `index`
+        static constexpr std::uint64_t BucketLowerBound(std::size_t index) {
+            if (index < kSubBuckets * 2) return index;
+            const auto shift = index / kSubBuckets - 1;
+            return (kSubBuckets + index % kSubBuckets) << shift;
+        }
+
+        void Record(std::uint64_t value) {
+            m_buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            auto max = m_max.load(std::memory_order_relaxed);
+            while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+            }
+        }
+
+        std::uint64_t Count() const { return m_count.load(std::memory_order_relaxed); }
+
+        std::uint64_t Max() const { return m_max.load(std::memory_order_relaxed); }
+
+        // Lower bound of the bucket holding the given percentile (0-100)
+        std::uint64_t Percentile(double percentile) const {
+            const auto count = Count();
+            if (count == 0) return 0;
+            const auto target = static_cast<std::uint64_t>(static_cast<double>(count) * percentile / 100.0);
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < kBucketCount; ++i) {
+                seen += m_buckets[i].load(std::memory_order_relaxed);
+                if (seen > target) return BucketLowerBound(i);
+            }
+            return Max();
+        }
+
+        void Reset() {
+            for (auto& bucket : m_buckets) bucket.store(0, std::memory_order_relaxed);
+            m_count.store(0, std::memory_order_relaxed);
+            m_max.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        std::array<std::atomic<std::uint64_t>, kBucketCount> m_buckets{};
+        std::atomic<std::uint64_t> m_count = 0;
+        std::atomic<std::uint64_t> m_max = 0;
+    };
+
+    // -------------------------------------------------------------------------
+    // Profiler:
+    // One histogram per stage. Disabled by default (EnableHotPathProfiling in
+    // the INI), in which case a probe costs one relaxed atomic load. Every
+    // `interval` the collected percentiles are written to the log sink and,
+    // optionally, appended to a CSV file; then the histograms start over.
+    // -------------------------------------------------------------------------
+    class Profiler {
+    public:
+        using LogSink = std::function<void(const std::string&)>;
+
+        void Configure(bool enabled, std::chrono::seconds interval, std::filesystem::path csvPath, LogSink logSink) {
+            std::scoped_lock lock(m_dumpLock);
+            m_interval = interval;
+            m_csvPath = std::move(csvPath);
+            m_logSink = std::move(logSink);
+            m_lastDump.store(Now(), std::memory_order_relaxed);
+            m_enabled.store(enabled, std::memory_order_release);
+        }
+
+        bool Enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+        void Record(Stage stage, std::int64_t ticks) {
+            m_histograms[static_cast<std::size_t>(stage)].Record(ticks > 0 ? static_cast<std::uint64_t>(ticks) : 0);
+        }
+
+        void MaybeDump(std::int64_t now) {
+            const auto intervalTicks = static_cast<std::int64_t>(
+                static_cast<double>(std::chrono::nanoseconds(m_interval).count()) / NanosecondsPerTick());
+            auto last = m_lastDump.load(std::memory_order_relaxed);
+            if (now - last < intervalTicks) return;
+            if (!m_lastDump.compare_exchange_strong(last, now, std::memory_order_relaxed)) return;
+            Dump();
+        }
+
+        void Dump() {
+            std::scoped_lock lock(m_dumpLock);
+            const double usPerTick = NanosecondsPerTick() / 1000.0;
+            std::ofstream csv;
+            if (!m_csvPath.empty()) {
+                const bool writeHeader = !std::filesystem::exists(m_csvPath);
+                csv.open(m_csvPath, std::ios::app);
+                if (writeHeader) csv << "unix_time,stage,count,p50_us,p90_us,p99_us,max_us\n";
+            }
+            const auto timestamp = static_cast<long long>(std::time(nullptr));
+            for (std::size_t i = 0; i < m_histograms.size(); ++i) {
+                auto& histogram = m_histograms[i];
+                if (histogram.Count() == 0) continue;
+                const double p50 = histogram.Percentile(50) * usPerTick, p90 = histogram.Percentile(90) * usPerTick,
+                             p99 = histogram.Percentile(99) * usPerTick, max = histogram.Max() * usPerTick;
+                if (m_logSink)
+                    m_logSink(std::format("Profile {:>9}: n={} p50={:.2f}us p90={:.2f}us p99={:.2f}us max={:.2f}us",
+                                          kStageNames[i], histogram.Count(), p50, p90, p99, max));
+                if (csv.is_open())
+                    csv << std::format("{},{},{},{:.3f},{:.3f},{:.3f},{:.3f}\n", timestamp, kStageNames[i],
+                                       histogram.Count(), p50, p90, p99, max);
+                histogram.Reset();
+            }
+        }
+
+    private:
+        std::array<Histogram, static_cast<std::size_t>(Stage::kCount)> m_histograms{};
+        std::atomic<bool> m_enabled = false;
+        std::atomic<std::int64_t> m_lastDump = 0;
+        std::chrono::seconds m_interval{60};
+        std::filesystem::path m_csvPath;
+        LogSink m_logSink;
+        std::mutex m_dumpLock;
+    };
+
+    inline Profiler& Get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    // -------------------------------------------------------------------------
+    // StageTimer:
+    // Lap timer for straight-line code. Every Lap() records the time since the
+    // previous lap under the given stage; the destructor records the Total,
+    // also on early returns. Use through the MANTELLA_PROFILE_* macros.
+    // -------------------------------------------------------------------------
+    class StageTimer {
+    public:
+        StageTimer() : m_enabled(Get().Enabled()) {
+            if (m_enabled) m_start = m_last = Now();
+        }
+
+        StageTimer(const StageTimer&) = delete;
+        StageTimer& operator=(const StageTimer&) = delete;
+
+        ~StageTimer() {
+            if (!m_enabled) return;
+            const auto now = Now();
+            Get().Record(Stage::Total, now - m_start);
+            Get().MaybeDump(now);
+        }
+
+        void Lap(Stage stage) {
+            if (!m_enabled) return;
+            const auto now = Now();
+            Get().Record(stage, now - m_last);
+            m_last = now;
+        }
+
+    private:
+        bool m_enabled;
+        std::int64_t m_start = 0;
+        std::int64_t m_last = 0;
+    };
+
+}
+
+#if MANTELLA_ENABLE_PROFILING
+    #define MANTELLA_PROFILE_START(timer) MantellaDialogueProfiler::StageTimer timer
+    #define MANTELLA_PROFILE_LAP(timer, stage) timer.Lap(MantellaDialogueProfiler::Stage::stage)
+#else
+    #define MANTELLA_PROFILE_START(timer)
+    #define MANTELLA_PROFILE_LAP(timer, stage)
+#endif
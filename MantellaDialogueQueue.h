@@ -0,0 +1,56 @@
+#pragma once
+#include <array>    // For std::array
+#include <atomic>   // For std::atomic
+#include <cstddef>  // For std::size_t
+#include <utility>  // For std::move
+
+namespace MantellaDialogueQueue {
+
+    // -------------------------------------------------------------------------
+    // Lock-free single-producer / single-consumer ring buffer.
+    // The producer (ShowSubtitle hook) only ever touches m_head, the consumer
+    // (the drain task) only ever touches m_tail, so neither side blocks.
+    // Capacity must be a power of two; one slot is never used to tell full from empty.
+    // -------------------------------------------------------------------------
+    template <class T, std::size_t Capacity>
+    class SpscRing {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        // Returns false if the ring is full; the value is left untouched in that case.
+        bool TryPush(T&& a_value) {
+            const auto head = m_head.load(std::memory_order_relaxed);
+            const auto next = (head + 1) & kMask;
+            if (next == m_tail.load(std::memory_order_acquire)) return false;
+            m_slots[head] = std::move(a_value);
+            m_head.store(next, std::memory_order_release);
+            return true;
+        }
+
+        // Returns false if the ring is empty.
+        bool TryPop(T& a_out) {
+            const auto tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire)) return false;
+            a_out = std::move(m_slots[tail]);
+            m_tail.store((tail + 1) & kMask, std::memory_order_release);
+            return true;
+        }
+
+        // Approximate when called concurrently, exact from either side's own thread.
+        std::size_t Size() const {
+            return (m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire)) & kMask;
+        }
+
+        bool Empty() const { return Size() == 0; }
+
+        static constexpr std::size_t MaxSize() { return Capacity - 1; }
+
+    private:
+        static constexpr std::size_t kMask = Capacity - 1;
+
+        std::array<T, Capacity> m_slots{};
+        alignas(64) std::atomic<std::size_t> m_head{0};
+        alignas(64) std::atomic<std::size_t> m_tail{0};
+    };
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <array>          // For std::array
+#include <cstddef>        // For std::size_t
+#include <cstdint>        // For fixed-width integer types
+#include <optional>       // For std::optional
+#include <string_view>    // For std::string_view
+#include <unordered_map>  // For std::unordered_map
+
+#include "MantellaDialogueDedup.h"
+#include "MantellaDialogueIniConfig.h"
+#include "MantellaDialogueText.h"
+
+namespace MantellaDialogueRules {
+
+    // Why an exchange is not sent to Mantella, in the order the rules are checked
+    enum class FilterReason : std::uint8_t {
+        None,
+        PlayerLineBlacklist,
+        NPCLineBlacklist,
+        Greeting,
+        ShortReply,
+        kCount
+    };
+
+    constexpr std::array<std::string_view, static_cast<std::size_t>(FilterReason::kCount)> kFilterReasonNames{
+        "None", "Player Line Blacklist", "NPC Line Blacklist", "Greeting", "Short reply"};
+
+    constexpr std::string_view Name(FilterReason reason) {
+        return kFilterReasonNames[static_cast<std::size_t>(reason)];
+    }
+
+    constexpr std::string_view kGreetings[] = {"Hello", "CYRGenericHello", "DialogueGenericHello"};
+
+    constexpr bool IsGreeting(std::string_view msg) {
+        for (auto greeting : kGreetings)
+            if (msg == greeting) return true;
+        return false;
+    }
+
+    // -------------------------------------------------------------------------
+    // The game-independent part of ShowSubtitle::ShouldFilterDialoge, so it can
+    // be benchmarked offline. `sayOnce` is the topic info's kSayOnce flag, or
+    // nullopt when there is no topic info (greetings are never filtered then).
+    // -------------------------------------------------------------------------
+    inline FilterReason Classify(const MantellaDialogueIniConfig::Configuration& config, std::string_view playerLine,
+                                 std::string_view npcLine, std::optional<bool> sayOnce) {
+        if (config.PlayerLineFilter.Matches(playerLine)) return FilterReason::PlayerLineBlacklist;
+        if (config.NPCLineFilter.Matches(npcLine)) return FilterReason::NPCLineBlacklist;
+        if (sayOnce.has_value() && !*sayOnce && config.FilterNonUniqueGreetings && IsGreeting(playerLine))
+            return FilterReason::Greeting;
+        const auto minWordCount = static_cast<std::size_t>(config.FilterShortRepliesMinWordCount);
+        if (config.FilterShortReplies && MantellaDialogueText::CountWords(npcLine, minWordCount) < minWordCount)
+            return FilterReason::ShortReply;
+        return FilterReason::None;
+    }
+
+    // What Classify decided for one topic info, and the DialogueLineFlags of its lines
+    struct TopicVerdict {
+        FilterReason reason = FilterReason::None;
+        std::uint32_t lineFlags = 0;
+    };
+
+    // -------------------------------------------------------------------------
+    // VerdictCache:
+    // Remembers the verdict per TESTopicInfo FormID, so generic barks that
+    // come up again and again are decided with one lookup. The same topic info
+    // can still come with other text: the player's line is whatever topic they
+    // picked, and responses can have aliases or names filled in at runtime. So
+    // an entry also keeps a hash of both lines and is only used when they
+    // match. Everything is dropped when a different configuration is used
+    // or kMaxEntries is reached. Only the ShowSubtitle hook uses it, on the
+    // main thread, so there is no locking.
+    // -------------------------------------------------------------------------
+    class VerdictCache {
+    public:
+        static constexpr std::size_t kMaxEntries = 8192;
+
+        const TopicVerdict* Find(std::uint32_t topicInfoID, std::string_view playerLine, std::string_view npcLine,
+                                 std::uint32_t configGeneration) {
+            if (configGeneration != m_generation) {  // Configuration::generation
+                m_entries.clear();
+                m_generation = configGeneration;
+                return nullptr;
+            }
+            const auto it = m_entries.find(topicInfoID);
+            if (it == m_entries.end() || it->second.linesHash != HashLines(playerLine, npcLine)) return nullptr;
+            return &it->second.verdict;
+        }
+
+        // Call with the same configGeneration the Find before it missed with
+        void Store(std::uint32_t topicInfoID, std::string_view playerLine, std::string_view npcLine,
+                   const TopicVerdict& verdict) {
+            if (m_entries.size() >= kMaxEntries) m_entries.clear();
+            m_entries.insert_or_assign(topicInfoID, Entry{verdict, HashLines(playerLine, npcLine)});
+        }
+
+        std::size_t Size() const { return m_entries.size(); }
+
+    private:
+        struct Entry {
+            TopicVerdict verdict;
+            std::uint64_t linesHash;
+        };
+
+        // The player's line seeds the hash of the NPC's, so swapping text between the two changes it too
+        static std::uint64_t HashLines(std::string_view playerLine, std::string_view npcLine) {
+            return MantellaDialogueDedup::Hash(npcLine, MantellaDialogueDedup::Hash(playerLine));
+        }
+
+        std::unordered_map<std::uint32_t, Entry> m_entries;
+        std::uint32_t m_generation = 0;
+    };
+
+}
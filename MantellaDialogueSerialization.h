@@ -0,0 +1,309 @@
+#pragma once
+#include <cstdint>        // For fixed-width integer types
+#include <cstring>        // For std::memcpy
+#include <string>         // For std::string
+#include <string_view>    // For std::string_view
+#include <vector>         // For std::vector
+
+#include "MantellaDialogueBacklog.h"
+#include "MantellaNamePool.h"
+
+namespace MantellaDialogueSerialization {
+
+    // 'HIST' v1: a single length-prefixed JSON blob. Only read, for migrating old co-saves.
+    constexpr std::uint32_t kJsonHistoryRecord = 'HIST';
+    // 'HIS2': binary dialogue history, layout (all integers little endian u32):
+    //   nameCount, nameCount x string      (the MantellaNamePool, index = NameId)
+    //   actorCount, actorCount x { formID, segmentBytes, lineCount, lineCount x line }
+    //   line   = playerNameIndex, string playerLine, npcNameIndex, string npcLine, f32 gameTimeHours, flags
+    //   string = length, length x UTF-8 bytes
+    // segmentBytes counts everything after itself up to the next actor, so a reader can skip actors.
+    // v1 is only that payload, without the line flags.
+    // v2 prefixes it with a u32 MantellaDialogueCompression::Codec and stores it accordingly.
+    // v3 (written) adds the line flags (Hooks::DialogueLineFlags).
+    constexpr std::uint32_t kHistoryRecord = 'HIS2';
+    constexpr std::uint32_t kPlainHistoryRecordVersion = 1;
+    constexpr std::uint32_t kCompressedHistoryRecordVersion = 2;
+    constexpr std::uint32_t kLineFlagsHistoryRecordVersion = 3;
+    constexpr std::uint32_t kHistoryRecordVersion = kLineFlagsHistoryRecordVersion;
+
+    // -------------------------------------------------------------------------
+    // Buffers small writes and hands them to the serialization interface in
+    // large chunks. Works with anything that has SKSE's
+    // `bool WriteRecordData(const void*, std::uint32_t)`.
+    // -------------------------------------------------------------------------
+    template <class Intfc>
+    class RecordWriter {
+    public:
+        static constexpr std::size_t kBufferSize = 64 * 1024;
+
+        explicit RecordWriter(Intfc* a_intfc) : m_intfc(a_intfc) { m_buffer.reserve(kBufferSize); }
+
+        void Write(const void* data, std::size_t size) {
+            if (!m_ok) return;
+            if (m_buffer.size() + size > kBufferSize) Flush();
+            if (size >= kBufferSize) {
+                m_ok = m_intfc->WriteRecordData(data, static_cast<std::uint32_t>(size));
+                m_written += size;
+                return;
+            }
+            const auto* bytes = static_cast<const char*>(data);
+            m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+        }
+
+        void WriteU32(std::uint32_t value) { Write(&value, sizeof(value)); }
+
+        void WriteFloat(float value) { Write(&value, sizeof(value)); }
+
+        void WriteString(std::string_view value) {
+            WriteU32(static_cast<std::uint32_t>(value.size()));
+            Write(value.data(), value.size());
+        }
+
+        bool Flush() {
+            if (m_ok && !m_buffer.empty())
+                m_ok = m_intfc->WriteRecordData(m_buffer.data(), static_cast<std::uint32_t>(m_buffer.size()));
+            m_written += m_buffer.size();
+            m_buffer.clear();
+            return m_ok;
+        }
+
+        bool Ok() const { return m_ok; }
+
+        std::size_t BytesWritten() const { return m_written + m_buffer.size(); }
+
+    private:
+        Intfc* m_intfc;
+        std::vector<char> m_buffer;
+        std::size_t m_written = 0;
+        bool m_ok = true;
+    };
+
+    // -------------------------------------------------------------------------
+    // Bounds-checked reader over a record payload that was read into memory.
+    // Every read fails (and keeps failing) once the payload is exhausted.
+    // -------------------------------------------------------------------------
+    class PayloadReader {
+    public:
+        explicit PayloadReader(std::string_view a_payload) : m_payload(a_payload) {}
+
+        bool ReadU32(std::uint32_t& out) { return ReadRaw(&out, sizeof(out)); }
+
+        bool ReadFloat(float& out) { return ReadRaw(&out, sizeof(out)); }
+
+        bool ReadString(std::string_view& out) {
+            std::uint32_t length = 0;
+            if (!ReadU32(length) || Remaining() < length) return m_ok = false;
+            out = m_payload.substr(m_pos, length);
+            m_pos += length;
+            return true;
+        }
+
+        bool Skip(std::size_t size) {
+            if (!m_ok || Remaining() < size) return m_ok = false;
+            m_pos += size;
+            return true;
+        }
+
+        std::size_t Position() const { return m_pos; }
+
+        std::size_t Remaining() const { return m_payload.size() - m_pos; }
+
+        bool Ok() const { return m_ok; }
+
+    private:
+        bool ReadRaw(void* out, std::size_t size) {
+            if (!m_ok || Remaining() < size) return m_ok = false;
+            std::memcpy(out, m_payload.data() + m_pos, size);
+            m_pos += size;
+            return true;
+        }
+
+        std::string_view m_payload;
+        std::size_t m_pos = 0;
+        bool m_ok = true;
+    };
+
+    // Byte size of one encoded line, used to fill in segmentBytes without a second pass
+    inline std::size_t EncodedLineSize(const MantellaDialogueBacklog::LineView& line) {
+        return 4 + 4 + line.playerLine.size() + 4 + 4 + line.npcLine.size() + 4 + 4;
+    }
+
+    namespace detail {
+        inline void AppendU32(std::string& out, std::uint32_t value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        inline void AppendFloat(std::string& out, float value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        inline void AppendString(std::string& out, std::string_view value) {
+            AppendU32(out, static_cast<std::uint32_t>(value.size()));
+            out.append(value);
+        }
+    }
+
+    // Encodes the name pool as it appears at the start of the record: nameCount, nameCount x string
+    inline void EncodeNamePool(std::string& out) {
+        auto& pool = MantellaNamePool::Names();
+        const auto nameCount = static_cast<std::uint32_t>(pool.Size());
+        detail::AppendU32(out, nameCount);
+        for (std::uint32_t id = 0; id < nameCount; ++id) detail::AppendString(out, pool.Get(id));
+    }
+
+    // Encodes one actor as it appears in the record: { formID, segmentBytes, lineCount, lineCount x line }.
+    // NameIds are written as they are: the pool never shrinks, so a cached segment stays valid across saves.
+    inline void EncodeActorSegment(const MantellaDialogueBacklog::ActorRing& actor, std::string& out) {
+        using MantellaDialogueBacklog::LineView;
+        std::size_t segmentBytes = 4;  // lineCount
+        actor.ForEach([&](const LineView& line) { segmentBytes += EncodedLineSize(line); });
+        out.reserve(out.size() + 8 + segmentBytes);
+        detail::AppendU32(out, actor.GetFormID());
+        detail::AppendU32(out, static_cast<std::uint32_t>(segmentBytes));
+        detail::AppendU32(out, static_cast<std::uint32_t>(actor.Size()));
+        actor.ForEach([&](const LineView& line) {
+            detail::AppendU32(out, line.playerName);
+            detail::AppendString(out, line.playerLine);
+            detail::AppendU32(out, line.npcName);
+            detail::AppendString(out, line.npcLine);
+            detail::AppendFloat(out, line.gameTimeHours);
+            detail::AppendU32(out, line.flags);
+        });
+    }
+
+    struct WriteStats {
+        std::size_t actorsEncoded = 0;  // actors whose lines changed since the previous save
+        std::size_t bytesWritten = 0;
+    };
+
+    // Writes the 'HIS2' payload. The record has to be opened by the caller.
+    // Only actors that changed since the last save are encoded again, all others reuse their cached segment.
+    template <class Intfc>
+    bool WriteDialogueHistory(Intfc* a_intfc, const MantellaDialogueBacklog::DialogueBacklog& history,
+                              WriteStats* stats = nullptr) {
+        using MantellaDialogueBacklog::ActorRing;
+
+        // The name pool is written once, lines refer to it by NameId
+        std::string names;
+        EncodeNamePool(names);
+
+        RecordWriter<Intfc> writer(a_intfc);
+        writer.Write(names.data(), names.size());
+        writer.WriteU32(static_cast<std::uint32_t>(history.ActorCount()));
+        std::size_t actorsEncoded = 0;
+        history.ForEachActor([&](const ActorRing& actor) {
+            if (!actor.HasSegment()) ++actorsEncoded;
+            const auto& segment = actor.Segment([&](std::string& out) { EncodeActorSegment(actor, out); });
+            writer.Write(segment.data(), segment.size());
+        });
+        const bool ok = writer.Flush();
+        if (stats) *stats = {actorsEncoded, writer.BytesWritten()};
+        return ok;
+    }
+
+    // Decodes the lines of a segment written by EncodeActorSegment, which ReadDialogueHistory already checked.
+    // The ActorRing::SegmentDecoder of loaded actors.
+    inline void DecodeActorSegment(std::string_view segment, std::vector<MantellaDialogueBacklog::LineView>& lines) {
+        PayloadReader reader(segment);
+        std::uint32_t lineCount = 0;
+        reader.Skip(8);  // formID, segmentBytes
+        reader.ReadU32(lineCount);
+        for (std::uint32_t i = 0; i < lineCount && reader.Ok(); ++i) {
+            MantellaDialogueBacklog::LineView line;
+            reader.ReadU32(line.playerName);
+            reader.ReadString(line.playerLine);
+            reader.ReadU32(line.npcName);
+            reader.ReadString(line.npcLine);
+            reader.ReadFloat(line.gameTimeHours);
+            reader.ReadU32(line.flags);
+            if (reader.Ok()) lines.push_back(line);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // Loads a 'HIS2' payload into `history` without decoding any lines: every
+    // actor's segment is checked, its name indices are rewritten to this
+    // session's NameIds, and it is handed to the backlog as is. The lines are
+    // decoded when the actor is first looked up, and untouched actors are
+    // saved again straight from their segment. Segments of records older
+    // than v3 are rebuilt with empty line flags. On failure `history` is left empty.
+    // -------------------------------------------------------------------------
+    inline bool ReadDialogueHistory(std::string_view payload, MantellaDialogueBacklog::DialogueBacklog& history,
+                                    std::uint32_t version = kHistoryRecordVersion) {
+        history.Clear();
+        PayloadReader reader(payload);
+        std::uint32_t nameCount = 0;
+        if (!reader.ReadU32(nameCount) || nameCount > reader.Remaining() / 4) return false;
+        // Ids of the saving session are remapped to the ids of this session's pool
+        std::vector<MantellaNamePool::NameId> names(nameCount);
+        bool sameIds = true;  // loading into a fresh session usually hands out the same ids again
+        for (std::uint32_t index = 0; index < nameCount; ++index) {
+            std::string_view text;
+            if (!reader.ReadString(text)) return false;
+            names[index] = MantellaNamePool::Intern(text);
+            sameIds = sameIds && names[index] == index;
+        }
+
+        auto fail = [&]() {
+            history.Clear();
+            return false;
+        };
+
+        const bool hasFlags = version >= kLineFlagsHistoryRecordVersion;
+        const std::uint32_t minLineBytes = hasFlags ? 24 : 20;
+        std::uint32_t actorCount = 0;
+        if (!reader.ReadU32(actorCount)) return false;
+        for (std::uint32_t actor = 0; actor < actorCount; ++actor) {
+            const auto actorStart = reader.Position();
+            std::uint32_t formID = 0, segmentBytes = 0, lineCount = 0;
+            if (!reader.ReadU32(formID) || !reader.ReadU32(segmentBytes) || reader.Remaining() < segmentBytes ||
+                !reader.ReadU32(lineCount) || lineCount > segmentBytes / minLineBytes)
+                return fail();
+            const auto actorEnd = reader.Position() - 4 + segmentBytes;
+            auto segment = std::make_shared<std::string>();
+            if (hasFlags) {
+                segment->assign(payload.substr(actorStart, actorEnd - actorStart));
+            } else {
+                segment->reserve(8 + segmentBytes + 4 * lineCount);
+                detail::AppendU32(*segment, formID);
+                detail::AppendU32(*segment, segmentBytes + 4 * lineCount);
+                detail::AppendU32(*segment, lineCount);
+            }
+
+            auto readName = [&]() {
+                const auto position = reader.Position();
+                std::uint32_t index = 0;
+                if (!reader.ReadU32(index) || index >= names.size()) return false;
+                if (!hasFlags)
+                    detail::AppendU32(*segment, names[index]);
+                else if (!sameIds)
+                    std::memcpy(segment->data() + (position - actorStart), &names[index], sizeof(index));
+                return true;
+            };
+            auto readString = [&]() {
+                std::string_view text;
+                if (!reader.ReadString(text)) return false;
+                if (!hasFlags) detail::AppendString(*segment, text);
+                return true;
+            };
+            float oldestHours = 0.0f, newestHours = 0.0f;
+            for (std::uint32_t i = 0; i < lineCount; ++i) {
+                std::uint32_t flags = 0;
+                if (!readName() || !readString() || !readName() || !readString() || !reader.ReadFloat(newestHours) ||
+                    (hasFlags && !reader.ReadU32(flags)))
+                    return fail();
+                if (!hasFlags) {
+                    detail::AppendFloat(*segment, newestHours);
+                    detail::AppendU32(*segment, flags);
+                }
+                if (i == 0) oldestHours = newestHours;
+            }
+            if (reader.Position() != actorEnd || !history.AdoptEncoded(formID, lineCount, oldestHours, newestHours,
+                                                                     std::move(segment), &DecodeActorSegment))
+                return fail();
+        }
+        return reader.Ok();
+    }
+
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <atomic>              // For std::atomic
+#include <chrono>              // For std::chrono::milliseconds
+#include <condition_variable>  // For std::condition_variable
+#include <cstddef>             // For std::size_t
+#include <cstdint>             // For fixed-width integer types
+#include <exception>           // For std::exception
+#include <memory>              // For std::shared_ptr
+#include <mutex>               // For std::mutex
+#include <string>              // For std::string
+#include <thread>              // For std::thread
+#include <vector>              // For std::vector
+
+#include "MantellaDialogueBacklog.h"
+#include "MantellaDialogueCompression.h"
+#include "MantellaDialogueSerialization.h"
+#include "logger.h"
+
+namespace MantellaDialogueSnapshot {
+
+    // An encoded 'HIS2' payload of the backlog as it was at `version`, split into the parts it is written from
+    struct Snapshot {
+        std::uint64_t version = 0;
+        std::string names;
+        std::vector<std::shared_ptr<const std::string>> segments;  // one per actor, FormID order
+        int compressionLevel = 0;  // 0: uncompressed. Otherwise `compressed` is the whole record.
+        std::string compressed;
+
+        // Uncompressed payload size
+        std::size_t Bytes() const {
+            std::size_t bytes = names.size() + 4;
+            for (const auto& segment : segments) bytes += segment->size();
+            return bytes;
+        }
+
+        std::size_t RecordBytes() const { return compressionLevel > 0 ? compressed.size() : 4 + Bytes(); }
+    };
+
+    namespace detail {
+        template <class Intfc>
+        bool WritePayload(Intfc* a_intfc, const Snapshot& snapshot) {
+            MantellaDialogueSerialization::RecordWriter<Intfc> writer(a_intfc);
+            writer.Write(snapshot.names.data(), snapshot.names.size());
+            writer.WriteU32(static_cast<std::uint32_t>(snapshot.segments.size()));
+            for (const auto& segment : snapshot.segments) writer.Write(segment->data(), segment->size());
+            return writer.Flush();
+        }
+    }
+
+    // Writes the snapshot as a 'HIS2' record body, codec first. The record has to be opened by the caller.
+    template <class Intfc>
+    bool WriteSnapshot(Intfc* a_intfc, const Snapshot& snapshot) {
+        if (snapshot.compressionLevel > 0)
+            return a_intfc->WriteRecordData(snapshot.compressed.data(),
+                                            static_cast<std::uint32_t>(snapshot.compressed.size()));
+        return MantellaDialogueCompression::WriteUncompressedHeader(a_intfc) && detail::WritePayload(a_intfc, snapshot);
+    }
+
+    // -------------------------------------------------------------------------
+    // SnapshotEncoder:
+    // Keeps an encoded snapshot of the backlog ready for the next save, so the
+    // save callback only copies bytes. A worker thread wakes up when told the
+    // backlog changed (or every kPollInterval), and then:
+    // - under the backlog lock, takes every actor's cached segment and copies
+    //   the lines of actors without one into a private scratch backlog
+    // - without the lock, encodes those actors
+    // - puts the new segments back into the actors' caches, unless the actor
+    //   changed again meanwhile, and publishes the snapshot with an atomic swap
+    // The lock is only held for the copy, which scales with what changed.
+    // With a compression level set, the snapshot is also compressed there.
+    // -------------------------------------------------------------------------
+    class SnapshotEncoder {
+    public:
+        // A burst of subtitles settles before it is encoded
+        static constexpr auto kDebounce = std::chrono::milliseconds(500);
+        static constexpr auto kPollInterval = std::chrono::seconds(5);
+
+        SnapshotEncoder(MantellaDialogueBacklog::DialogueBacklog& a_history, std::mutex& a_historyLock)
+            : m_history(a_history), m_historyLock(a_historyLock) {}
+
+        SnapshotEncoder(const SnapshotEncoder&) = delete;
+        SnapshotEncoder& operator=(const SnapshotEncoder&) = delete;
+
+        ~SnapshotEncoder() { Stop(); }
+
+        void Start() {
+            if (m_worker.joinable()) return;
+            m_stop = false;
+            m_worker = std::thread([this]() { Run(); });
+        }
+
+        void Stop() {
+            {
+                std::scoped_lock lock(m_wakeLock);
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            if (m_worker.joinable()) m_worker.join();
+        }
+
+        // Never blocks: a wake-up that races with the worker going to sleep is picked up by the next poll
+        void NotifyChanged() {
+            m_changed.store(true, std::memory_order_release);
+            m_wake.notify_one();
+        }
+
+        // zstd level of the snapshots from now on, 0 to keep them uncompressed
+        void SetCompressionLevel(int level) {
+            m_compressionLevel.store(level, std::memory_order_relaxed);
+            NotifyChanged();
+        }
+
+        // The latest snapshot, nullptr before the first one. Compare its version with the backlog's to use it.
+        std::shared_ptr<const Snapshot> Current() const { return m_current.load(std::memory_order_acquire); }
+
+        // One snapshot pass on the calling thread. Returns false if the current snapshot was still up to date.
+        bool Update() {
+            using MantellaDialogueBacklog::ActorRing;
+            using MantellaDialogueBacklog::LineView;
+            struct Pending {
+                std::size_t index;
+                MantellaDialogueBacklog::FormID formID;
+                std::uint64_t actorVersion;
+            };
+
+            const int compressionLevel = m_compressionLevel.load(std::memory_order_relaxed);
+            auto snapshot = std::make_shared<Snapshot>();
+            MantellaDialogueBacklog::DialogueBacklog scratch;
+            std::vector<Pending> pending;
+            {
+                std::scoped_lock lock(m_historyLock);
+                snapshot->version = m_history.Version();
+                if (auto current = Current(); current && current->version == snapshot->version &&
+                                              current->compressionLevel == compressionLevel)
+                    return false;
+                scratch.SetLinesPerActor(m_history.LinesPerActor());
+                snapshot->segments.reserve(m_history.ActorCount());
+                m_history.ForEachActor([&](const ActorRing& actor) {
+                    if (auto segment = actor.SegmentPtr()) {
+                        snapshot->segments.push_back(std::move(segment));
+                        return;
+                    }
+                    pending.push_back({snapshot->segments.size(), actor.GetFormID(), actor.Version()});
+                    snapshot->segments.emplace_back();
+                    actor.ForEach([&](const LineView& line) { scratch.Push(actor.GetFormID(), line); });
+                });
+            }
+
+            for (const auto& actor : pending) {
+                auto segment = std::make_shared<std::string>();
+                MantellaDialogueSerialization::EncodeActorSegment(*scratch.Find(actor.formID), *segment);
+                snapshot->segments[actor.index] = std::move(segment);
+            }
+            // After the segments, so every NameId they use is in it
+            MantellaDialogueSerialization::EncodeNamePool(snapshot->names);
+
+            if (!pending.empty()) {
+                std::scoped_lock lock(m_historyLock);
+                for (const auto& actor : pending)
+                    if (auto ring = m_history.Peek(actor.formID))
+                        ring->SetSegment(snapshot->segments[actor.index], actor.actorVersion);
+            }
+            if (compressionLevel > 0) {
+                MantellaDialogueCompression::StringRecord record;
+                MantellaDialogueCompression::CompressingRecord<MantellaDialogueCompression::StringRecord> compressor(
+                    &record, compressionLevel);
+                if (!detail::WritePayload(&compressor, *snapshot) || !compressor.Finish()) return false;
+                snapshot->compressed = std::move(record.data);
+                snapshot->compressionLevel = compressionLevel;
+            }
+            m_current.store(std::move(snapshot), std::memory_order_release);
+            return true;
+        }
+
+    private:
+        void Run() {
+            std::unique_lock lock(m_wakeLock);
+            while (!m_stop) {
+                m_wake.wait_for(lock, kPollInterval,
+                                [this]() { return m_stop || m_changed.load(std::memory_order_acquire); });
+                if (m_stop) break;
+                m_wake.wait_for(lock, kDebounce, [this]() { return m_stop; });
+                if (m_stop) break;
+                m_changed.store(false, std::memory_order_release);
+                lock.unlock();
+                try {
+                    Update();
+                } catch (const std::exception& e) {
+                    logger::error("!!! SnapshotEncoder: Failed to encode the dialogue history: {}", e.what());
+                }
+                lock.lock();
+            }
+        }
+
+        MantellaDialogueBacklog::DialogueBacklog& m_history;
+        std::mutex& m_historyLock;
+        std::atomic<std::shared_ptr<const Snapshot>> m_current;
+        std::atomic<int> m_compressionLevel = 0;
+        std::atomic<bool> m_changed = false;
+        std::mutex m_wakeLock;
+        std::condition_variable m_wake;
+        bool m_stop = false;
+        std::thread m_worker;
+    };
+
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include <algorithm>     // For std::partial_sort, std::min
+#include <array>         // For std::array
+#include <atomic>        // For std::atomic
+#include <chrono>        // For std::chrono::steady_clock
+#include <cstddef>       // For std::size_t
+#include <cstdint>       // For fixed-width integer types
+#include <iterator>      // For std::back_inserter
+#include <string>        // For std::string
+#include <string_view>   // For std::string_view
+#include <vector>        // For std::vector
+
+#include <spdlog/fmt/fmt.h>  // For fmt::format_to, the fmt that logger:: uses
+
+#include "MantellaDialogueBacklog.h"
+#include "MantellaDialogueRules.h"
+
+namespace MantellaDialogueStats {
+
+    using MantellaDialogueRules::FilterReason;
+
+    // -------------------------------------------------------------------------
+    // Counters:
+    // What the plugin did since the game started. Bumped from the hook, the
+    // dispatchers and the save callback with relaxed atomics, read together
+    // with Take() for the summary. Nothing here is reset on load.
+    // -------------------------------------------------------------------------
+    struct Counters {
+        std::atomic<std::uint64_t> subtitles = 0;     // exchanges the hook built
+        std::atomic<std::uint64_t> ignoredNpcs = 0;   // speaker on NPCNamesToIgnore
+        std::atomic<std::uint64_t> repeated = 0;      // same topic as the previous subtitle
+        // [None] counts the exchanges that passed
+        std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(FilterReason::kCount)> byReason{};
+        std::atomic<std::uint64_t> linesStored = 0;   // went into the backlog
+        std::atomic<std::uint64_t> eventsSent = 0;    // events handed to Papyrus or the HTTP channel
+        std::atomic<std::uint64_t> eventBytes = 0;
+        std::atomic<std::uint64_t> replays = 0;       // backlogs replayed into a conversation
+        std::atomic<std::uint64_t> replayChars = 0;
+        std::atomic<std::uint64_t> largestReplayChars = 0;
+        std::atomic<std::uint64_t> saves = 0;
+        std::atomic<std::uint64_t> saveMicros = 0;
+        std::atomic<std::uint64_t> slowestSaveMicros = 0;
+        std::atomic<std::uint64_t> lastSaveBytes = 0;
+    };
+
+    inline Counters& Get() {
+        static Counters counters;
+        return counters;
+    }
+
+    namespace detail {
+        inline void Add(std::atomic<std::uint64_t>& counter, std::uint64_t value = 1) {
+            counter.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        inline void Max(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+            auto current = counter.load(std::memory_order_relaxed);
+            while (current < value && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+            }
+        }
+    }
+
+    inline void RecordSubtitle() { detail::Add(Get().subtitles); }
+
+    inline void RecordIgnoredNpc() { detail::Add(Get().ignoredNpcs); }
+
+    inline void RecordRepeat() { detail::Add(Get().repeated); }
+
+    // FilterReason::None for an exchange that passed the filters
+    inline void RecordVerdict(FilterReason reason) { detail::Add(Get().byReason[static_cast<std::size_t>(reason)]); }
+
+    inline void RecordStored() { detail::Add(Get().linesStored); }
+
+    inline void RecordSent(std::size_t events, std::size_t bytes) {
+        detail::Add(Get().eventsSent, events);
+        detail::Add(Get().eventBytes, bytes);
+    }
+
+    inline void RecordReplay(std::size_t chars) {
+        detail::Add(Get().replays);
+        detail::Add(Get().replayChars, chars);
+        detail::Max(Get().largestReplayChars, chars);
+    }
+
+    inline void RecordSave(std::chrono::microseconds elapsed, std::size_t bytes) {
+        const auto micros = static_cast<std::uint64_t>(elapsed.count());
+        detail::Add(Get().saves);
+        detail::Add(Get().saveMicros, micros);
+        detail::Max(Get().slowestSaveMicros, micros);
+        Get().lastSaveBytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    // A plain copy of the counters
+    struct Snapshot {
+        std::uint64_t subtitles, ignoredNpcs, repeated, linesStored, eventsSent, eventBytes;
+        std::array<std::uint64_t, static_cast<std::size_t>(FilterReason::kCount)> byReason;
+        std::uint64_t replays, replayChars, largestReplayChars;
+        std::uint64_t saves, saveMicros, slowestSaveMicros, lastSaveBytes;
+        std::chrono::steady_clock::time_point taken;
+    };
+
+    inline Snapshot Take() {
+        const auto& c = Get();
+        auto load = [](const std::atomic<std::uint64_t>& counter) { return counter.load(std::memory_order_relaxed); };
+        Snapshot s{};
+        s.subtitles = load(c.subtitles);
+        s.ignoredNpcs = load(c.ignoredNpcs);
+        s.repeated = load(c.repeated);
+        for (std::size_t i = 0; i < s.byReason.size(); ++i) s.byReason[i] = load(c.byReason[i]);
+        s.linesStored = load(c.linesStored);
+        s.eventsSent = load(c.eventsSent);
+        s.eventBytes = load(c.eventBytes);
+        s.replays = load(c.replays);
+        s.replayChars = load(c.replayChars);
+        s.largestReplayChars = load(c.largestReplayChars);
+        s.saves = load(c.saves);
+        s.saveMicros = load(c.saveMicros);
+        s.slowestSaveMicros = load(c.slowestSaveMicros);
+        s.lastSaveBytes = load(c.lastSaveBytes);
+        s.taken = std::chrono::steady_clock::now();
+        return s;
+    }
+
+    // -------------------------------------------------------------------------
+    // Backlog usage: counted when asked for rather than kept up to date on
+    // every push, a summary is rare and the hook stays untouched. An actor
+    // whose backlog is still encoded is counted with its encoded size.
+    // -------------------------------------------------------------------------
+    struct ActorUsage {
+        MantellaDialogueBacklog::FormID formID = 0;
+        std::size_t lines = 0;
+        std::size_t bytes = 0;
+    };
+
+    struct BacklogUsage {
+        std::size_t actors = 0;
+        std::size_t lines = 0;
+        std::size_t textBytes = 0;
+        std::size_t arenaBytes = 0;
+        std::vector<ActorUsage> largest;  // by bytes, largest first
+    };
+
+    // Has to be called with the backlog's lock held
+    inline BacklogUsage MeasureBacklog(const MantellaDialogueBacklog::DialogueBacklog& backlog, std::size_t top) {
+        BacklogUsage usage;
+        usage.actors = backlog.ActorCount();
+        usage.lines = backlog.LineCount();
+        usage.arenaBytes = backlog.ArenaBytes();
+        std::vector<ActorUsage> actors;
+        actors.reserve(backlog.ActorCount());
+        backlog.ForEachActor([&](const MantellaDialogueBacklog::ActorRing& actor) {
+            ActorUsage entry{actor.GetFormID(), actor.Size(), 0};
+            if (actor.IsEncoded()) {
+                if (auto segment = actor.SegmentPtr()) entry.bytes = segment->size();
+            } else
+                actor.ForEach([&](const MantellaDialogueBacklog::LineView& line) { entry.bytes += line.TextBytes(); });
+            usage.textBytes += entry.bytes;
+            actors.push_back(entry);
+        });
+        const auto count = std::min(top, actors.size());
+        std::partial_sort(actors.begin(), actors.begin() + static_cast<std::ptrdiff_t>(count), actors.end(),
+                          [](const ActorUsage& a, const ActorUsage& b) { return a.bytes > b.bytes; });
+        usage.largest.assign(actors.begin(), actors.begin() + static_cast<std::ptrdiff_t>(count));
+        return usage;
+    }
+
+    // -------------------------------------------------------------------------
+    // One line for the log or Papyrus. With `previous`, the rates are over the
+    // time since then, otherwise only the totals are written.
+    // -------------------------------------------------------------------------
+    inline std::string Summary(const Snapshot& now, const BacklogUsage& backlog, const Snapshot* previous = nullptr) {
+        std::string out;
+        auto it = std::back_inserter(out);
+        fmt::format_to(it, "subtitles={} ", now.subtitles);
+        if (previous) {
+            const auto minutes = std::chrono::duration<double, std::ratio<60>>(now.taken - previous->taken).count();
+            if (minutes > 0.0)
+                fmt::format_to(it, "({:.1f}/min, {:.1f} events/min) ",
+                               static_cast<double>(now.subtitles - previous->subtitles) / minutes,
+                               static_cast<double>(now.eventsSent - previous->eventsSent) / minutes);
+        }
+        fmt::format_to(it, "ignoredNpc={} repeated={}", now.ignoredNpcs, now.repeated);
+        fmt::format_to(it, " passed={} filtered:", now.byReason[0]);
+        for (std::size_t i = 1; i < now.byReason.size(); ++i)
+            fmt::format_to(it, "{} {} {}", i == 1 ? "" : ",", Name(static_cast<FilterReason>(i)), now.byReason[i]);
+        fmt::format_to(it, " | stored={} sent={} ({} bytes)", now.linesStored, now.eventsSent, now.eventBytes);
+        fmt::format_to(it, " | replays={} avgChars={} maxChars={}", now.replays,
+                       now.replays ? now.replayChars / now.replays : 0, now.largestReplayChars);
+        fmt::format_to(it, " | saves={} avgSaveUs={} maxSaveUs={} lastSaveBytes={}", now.saves,
+                       now.saves ? now.saveMicros / now.saves : 0, now.slowestSaveMicros, now.lastSaveBytes);
+        fmt::format_to(it, " | backlog: actors={} lines={} textBytes={} arenaBytes={}", backlog.actors, backlog.lines,
+                       backlog.textBytes, backlog.arenaBytes);
+        if (!backlog.largest.empty()) {
+            out += " largest:";
+            for (const auto& actor : backlog.largest)
+                fmt::format_to(it, " {:08X}={}B/{}", actor.formID, actor.bytes, actor.lines);
+        }
+        return out;
+    }
+
+}
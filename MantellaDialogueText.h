@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>    // For std::min
+#include <bit>          // For std::popcount
+#include <cstddef>      // For std::size_t
+#include <cstdint>      // For fixed-width integer types
+#include <limits>       // For std::numeric_limits
+#include <string_view>  // For std::string_view
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define MANTELLA_TEXT_AVX2 1
+#endif
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+    #include <emmintrin.h>
+    #define MANTELLA_TEXT_SSE2 1
+#endif
+
+namespace MantellaDialogueText {
+
+    // Space, \t, \n, \v, \f, \r
+    constexpr bool IsWhitespace(unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    namespace detail {
+        // A word starts at every non-whitespace byte whose predecessor is whitespace.
+        // `carry` is 1 if the byte before this block was whitespace (or the text starts here).
+        template <class Mask>
+        inline std::size_t CountWordStarts(Mask whitespace, Mask& carry, unsigned width) {
+            const Mask starts = ~whitespace & ((whitespace << 1) | carry);
+            carry = (whitespace >> (width - 1)) & 1;
+            return static_cast<std::size_t>(std::popcount(starts));
+        }
+
+#if MANTELLA_TEXT_SSE2
+        inline std::uint32_t WhitespaceMask(__m128i bytes) {
+            const __m128i space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+            // (c - '\t') as unsigned <= 4  <=>  '\t' <= c <= '\r'
+            const __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+            const __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(space, control)));
+        }
+#endif
+
+#if MANTELLA_TEXT_AVX2
+        inline std::uint64_t WhitespaceMask(__m256i bytes) {
+            const __m256i space = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+            const __m256i shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+            const __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+            return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(space, control)));
+        }
+#endif
+    }
+
+    // -------------------------------------------------------------------------
+    // Counts whitespace separated words without allocating. Runs of whitespace
+    // count as one separator. Stops scanning as soon as `limit` words were seen,
+    // so `CountWords(line, n) < n` is the cheap way to ask "fewer than n words?".
+    // Long NPC monologues are scanned 32 (AVX2) or 16 (SSE2) bytes at a time.
+    // -------------------------------------------------------------------------
+    inline std::size_t CountWords(std::string_view text,
+                                  std::size_t limit = std::numeric_limits<std::size_t>::max()) {
+        const auto* data = reinterpret_cast<const unsigned char*>(text.data());
+        const std::size_t size = text.size();
+        std::size_t i = 0;
+        std::size_t count = 0;
+        std::uint64_t carry = 1;
+
+#if MANTELLA_TEXT_AVX2
+        for (; i + 32 <= size && count < limit; i += 32) {
+            const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            std::uint64_t ws = detail::WhitespaceMask(bytes);
+            // Set the bits above the block width so the shifted-in carry can't leak into them
+            count += detail::CountWordStarts<std::uint64_t>(ws | 0xFFFFFFFF00000000ull, carry, 32);
+        }
+#endif
+#if MANTELLA_TEXT_SSE2
+        for (; i + 16 <= size && count < limit; i += 16) {
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            std::uint64_t ws = detail::WhitespaceMask(bytes);
+            count += detail::CountWordStarts<std::uint64_t>(ws | 0xFFFFFFFFFFFF0000ull, carry, 16);
+        }
+#endif
+        for (; i < size && count < limit; ++i) {
+            const bool ws = IsWhitespace(data[i]);
+            if (!ws && carry) ++count;
+            carry = ws ? 1 : 0;
+        }
+        return std::min(count, limit);
+    }
+
+    // -------------------------------------------------------------------------
+    // Calls `callback(std::string_view)` for every token between delimiters,
+    // with the same semantics as repeated std::getline: a trailing delimiter
+    // does not produce an empty last token, and empty input yields no tokens.
+    // -------------------------------------------------------------------------
+    template <class Callback>
+    inline void ForEachToken(std::string_view text, char delimiter, Callback&& callback) {
+        std::size_t start = 0;
+        while (start < text.size()) {
+            auto end = text.find(delimiter, start);
+            if (end == std::string_view::npos) end = text.size();
+            callback(text.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    // Trims spaces, tabs and line breaks from both ends
+    inline std::string_view Trim(std::string_view text) {
+        const char* whitespace = " \t\n\r";
+        const auto start = text.find_first_not_of(whitespace);
+        if (start == std::string_view::npos) return {};
+        const auto end = text.find_last_not_of(whitespace);
+        return text.substr(start, end - start + 1);
+    }
+
+}
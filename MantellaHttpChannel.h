@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>           // For std::min
+#include <chrono>              // For std::chrono::steady_clock
+#include <condition_variable>  // For std::condition_variable
+#include <cstddef>             // For std::size_t
+#include <cstdint>             // For fixed-width integer types
+#include <deque>               // For std::deque
+#include <functional>          // For std::function
+#include <mutex>               // For std::mutex
+#include <string>              // For std::string
+#include <thread>              // For std::thread
+#include <vector>              // For std::vector
+
+#if defined(_WIN32)
+    #include <Windows.h>
+    #include <winhttp.h>
+#endif
+
+#include "json.h"  // Include nlohmann/json library
+#include "logger.h"
+
+namespace MantellaHttpChannel {
+
+    // -------------------------------------------------------------------------
+    // Body of one POST: {"events": ["...", ...]}, the same strings that would
+    // otherwise go to AddMantellaEvent(s). Game text is not always valid
+    // UTF-8, broken sequences become U+FFFD instead of failing the batch.
+    // -------------------------------------------------------------------------
+    inline std::string EncodeEvents(const std::vector<std::string>& events) {
+        return nlohmann::json{{"events", events}}.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    }
+
+#if defined(_WIN32)
+    // -------------------------------------------------------------------------
+    // HttpChannel:
+    // Sends batches of events straight to the Mantella server on 127.0.0.1,
+    // bypassing Papyrus strings. One worker thread owns the WinHTTP session
+    // and connection, so requests reuse the same keep-alive connection.
+    // - Post() only queues, at most kMaxQueued batches; when the queue is
+    //   full it returns false and the caller sends the batch another way
+    // - a failed POST is retried kMaxAttempts times with a growing delay,
+    //   after that the batch goes to the fallback callback
+    // - after a failure Post() refuses batches for kCooldown, so a server
+    //   that is down costs one timeout instead of one per batch
+    // -------------------------------------------------------------------------
+    class HttpChannel {
+    public:
+        static constexpr std::size_t kMaxQueued = 64;
+        static constexpr int kMaxAttempts = 3;
+        static constexpr auto kRetryDelay = std::chrono::milliseconds(200);
+        static constexpr auto kCooldown = std::chrono::seconds(30);
+        static constexpr int kTimeoutMs = 2000;
+
+        // Called on the worker thread with the events of a batch that could not be delivered
+        using FallbackCallback = std::function<void(std::vector<std::string>)>;
+
+        explicit HttpChannel(FallbackCallback onFailed) : m_onFailed(std::move(onFailed)) {}
+
+        HttpChannel(const HttpChannel&) = delete;
+        HttpChannel& operator=(const HttpChannel&) = delete;
+
+        ~HttpChannel() {
+            {
+                std::scoped_lock lock(m_lock);
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            if (m_worker.joinable()) m_worker.join();
+            if (m_connection) WinHttpCloseHandle(m_connection);
+            if (m_session) WinHttpCloseHandle(m_session);
+        }
+
+        // Queues `events` for a POST to http://127.0.0.1:<port><path>. False if they were not taken, `events` is
+        // left as it was then.
+        bool Post(int port, std::string path, std::vector<std::string>& events) {
+            {
+                std::scoped_lock lock(m_lock);
+                if (m_stop || m_queue.size() >= kMaxQueued || std::chrono::steady_clock::now() < m_cooldownUntil)
+                    return false;
+                m_queue.push_back({port, std::move(path), std::move(events)});
+                if (!m_worker.joinable()) m_worker = std::thread([this]() { Run(); });
+            }
+            m_wake.notify_one();
+            return true;
+        }
+
+    private:
+        struct Batch {
+            int port;
+            std::string path;
+            std::vector<std::string> events;
+        };
+
+        void Run() {
+            std::unique_lock lock(m_lock);
+            while (true) {
+                m_wake.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+                if (m_stop) return;
+                auto batch = std::move(m_queue.front());
+                m_queue.pop_front();
+                lock.unlock();
+
+                const auto body = EncodeEvents(batch.events);
+                bool sent = false;
+                for (int attempt = 0; attempt < kMaxAttempts && !sent; ++attempt) {
+                    if (attempt > 0) std::this_thread::sleep_for(kRetryDelay * (1 << (attempt - 1)));
+                    sent = Send(batch.port, batch.path, body);
+                }
+                if (!sent) {
+                    logger::warn("HttpChannel: Could not reach the Mantella server on port {}, using Papyrus for {}s",
+                                 batch.port, std::chrono::duration_cast<std::chrono::seconds>(kCooldown).count());
+                    std::deque<Batch> failed;
+                    {
+                        std::scoped_lock failedLock(m_lock);
+                        m_cooldownUntil = std::chrono::steady_clock::now() + kCooldown;
+                        failed.swap(m_queue);
+                    }
+                    // Everything still queued would hit the same server, in order
+                    m_onFailed(std::move(batch.events));
+                    for (auto& queued : failed) m_onFailed(std::move(queued.events));
+                }
+                lock.lock();
+            }
+        }
+
+        bool Connect(int port) {
+            if (!m_session) {
+                m_session = WinHttpOpen(L"MantellaDialogue", WINHTTP_ACCESS_TYPE_NO_PROXY, WINHTTP_NO_PROXY_NAME,
+                                        WINHTTP_NO_PROXY_BYPASS, 0);
+                if (!m_session) return false;
+                WinHttpSetTimeouts(m_session, kTimeoutMs, kTimeoutMs, kTimeoutMs, kTimeoutMs);
+            }
+            if (m_connection && m_connectedPort == port) return true;
+            if (m_connection) WinHttpCloseHandle(m_connection);
+            m_connection = WinHttpConnect(m_session, L"127.0.0.1", static_cast<INTERNET_PORT>(port), 0);
+            m_connectedPort = m_connection ? port : 0;
+            return m_connection != nullptr;
+        }
+
+        bool Send(int port, const std::string& path, const std::string& body) {
+            if (port <= 0 || port > 65535 || !Connect(port)) return false;
+            const std::wstring widePath(path.begin(), path.end());  // the path is ASCII
+            HINTERNET request = WinHttpOpenRequest(m_connection, L"POST", widePath.c_str(), nullptr,
+                                                   WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, 0);
+            if (!request) return false;
+            static constexpr wchar_t kHeaders[] = L"Content-Type: application/json\r\n";
+            DWORD status = 0;
+            DWORD statusSize = sizeof(status);
+            bool ok = WinHttpSendRequest(request, kHeaders, static_cast<DWORD>(-1L),
+                                         const_cast<char*>(body.data()), static_cast<DWORD>(body.size()),
+                                         static_cast<DWORD>(body.size()), 0) &&
+                      WinHttpReceiveResponse(request, nullptr) &&
+                      WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                                          WINHTTP_HEADER_NAME_BY_INDEX, &status, &statusSize,
+                                          WINHTTP_NO_HEADER_INDEX);
+            // The response has to be read to the end before the connection can be reused
+            char sink[512];
+            DWORD available = 0;
+            while (ok && WinHttpQueryDataAvailable(request, &available) && available > 0) {
+                DWORD read = 0;
+                if (!WinHttpReadData(request, sink, std::min<DWORD>(available, sizeof(sink)), &read) || read == 0)
+                    break;
+            }
+            WinHttpCloseHandle(request);
+            if (ok && (status < 200 || status >= 300)) {
+                logger::debug("HttpChannel: Server answered {} to {}", status, path);
+                ok = false;
+            }
+            return ok;
+        }
+
+        FallbackCallback m_onFailed;
+        std::mutex m_lock;
+        std::condition_variable m_wake;
+        // Guarded by m_lock
+        std::deque<Batch> m_queue;
+        std::chrono::steady_clock::time_point m_cooldownUntil{};
+        bool m_stop = false;
+        std::thread m_worker;
+        // Worker thread only
+        HINTERNET m_session = nullptr;
+        HINTERNET m_connection = nullptr;
+        int m_connectedPort = 0;
+    };
+#endif
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>        // For fixed-width integer types
+#include <deque>          // For std::deque
+#include <mutex>          // For std::unique_lock
+#include <shared_mutex>   // For std::shared_mutex
+#include <string>         // For std::string
+#include <string_view>    // For std::string_view
+#include <unordered_map>  // For std::unordered_map
+
+namespace MantellaNamePool {
+
+    // Small handle to an interned name. 0 is always the empty name.
+    using NameId = std::uint32_t;
+    constexpr NameId kEmptyName = 0;
+
+    // -------------------------------------------------------------------------
+    // NamePool:
+    // There are only a handful of player names and one name per actor, so
+    // DialogueLine stores a NameId instead of its own std::string copies.
+    // Names are never removed: ids stay valid for the whole session and the
+    // std::string_views handed out by Get() never dangle (std::deque does not
+    // move its elements on push_back).
+    // -------------------------------------------------------------------------
+    class NamePool {
+    public:
+        NamePool() { m_names.emplace_back(); }
+
+        NameId Intern(std::string_view name) {
+            if (name.empty()) return kEmptyName;
+            {
+                std::shared_lock lock(m_lock);
+                if (auto it = m_ids.find(name); it != m_ids.end()) return it->second;
+            }
+            std::unique_lock lock(m_lock);
+            if (auto it = m_ids.find(name); it != m_ids.end()) return it->second;
+            auto id = static_cast<NameId>(m_names.size());
+            const auto& stored = m_names.emplace_back(name);
+            m_ids.emplace(stored, id);
+            return id;
+        }
+
+        std::string_view Get(NameId id) const {
+            std::shared_lock lock(m_lock);
+            return id < m_names.size() ? std::string_view(m_names[id]) : std::string_view();
+        }
+
+        std::size_t Size() const {
+            std::shared_lock lock(m_lock);
+            return m_names.size();
+        }
+
+    private:
+        mutable std::shared_mutex m_lock;
+        std::deque<std::string> m_names;
+        std::unordered_map<std::string_view, NameId> m_ids;
+    };
+
+    inline NamePool& Names() {
+        static NamePool pool;
+        return pool;
+    }
+
+    inline NameId Intern(std::string_view name) { return Names().Intern(name); }
+
+    inline std::string_view Get(NameId id) { return Names().Get(id); }
+
+}
@@ -1,23 +1,117 @@
 #pragma once
-#include <string>  // For std::string
+#include <atomic>    // For std::atomic
+#include <memory>    // For std::shared_ptr
+#include <mutex>     // For std::mutex
+#include <optional>  // For std::optional
+#include <string>    // For std::string
+#include <vector>    // For std::vector
+
+#include "MantellaDialogueDedup.h"
 
 namespace MantellaPapyrusInterface {
-    static inline std::string PreviousSentEvent = "";
+    // Hashes of the most recently sent events, sized by DedupWindowSize in the INI
+    static inline MantellaDialogueDedup::DedupWindow s_sentEvents{};
 
-    void AddMantellaEvent(std::string msg, bool deduplicate = true) {
-        if (deduplicate && msg == PreviousSentEvent) {
-            logger::debug("Skipping duplicate event: {}", msg);
+    // -------------------------------------------------------------------------
+    // ScriptCache:
+    // The Mantella quests are looked up once at kDataLoaded. Their VM handles and
+    // bound script objects are resolved on first use after every load and dropped
+    // again whenever the VM state goes away (revert / new game / load).
+    // -------------------------------------------------------------------------
+    struct ScriptCache {
+        RE::TESQuest* interfaceQuest = nullptr;   // 0x03D41A, has the MantellaInterface script
+        RE::TESQuest* repositoryQuest = nullptr;  // 0xD62, has the MantellaRepository script
+        RE::VMHandle interfaceHandle = 0;
+        RE::VMHandle repositoryHandle = 0;
+        RE::BSTSmartPointer<RE::BSScript::Object> interfaceScript = nullptr;
+        RE::BSTSmartPointer<RE::BSScript::Object> repositoryScript = nullptr;
+        std::optional<bool> interfaceHasAddEvents;  // MantellaInterface.AddMantellaEvents(string[]) exists
+    };
+
+    static inline ScriptCache s_scriptCache{};
+    static inline std::mutex s_scriptCacheLock;
+    static inline std::atomic<std::uint64_t> s_scriptCacheHits = 0;
+    static inline std::atomic<std::uint64_t> s_scriptCacheMisses = 0;
+
+    static RE::VMHandle GetQuestHandle(RE::BSScript::Internal::VirtualMachine* vm, RE::TESQuest* quest) {
+        if (!vm || !quest) return 0;
+        return vm->GetObjectHandlePolicy()->GetHandleForObject(quest->GetFormType(), quest);
+    }
+
+    // Resolves the handle and bound script object for one quest, unless they are cached already.
+    // Has to be called with s_scriptCacheLock held.
+    static RE::BSTSmartPointer<RE::BSScript::Object> ResolveScript(RE::TESQuest* quest, const char* scriptName,
+                                                                  RE::VMHandle& handle,
+                                                                  RE::BSTSmartPointer<RE::BSScript::Object>& script) {
+        if (script) {
+            s_scriptCacheHits.fetch_add(1, std::memory_order_relaxed);
+            return script;
+        }
+        s_scriptCacheMisses.fetch_add(1, std::memory_order_relaxed);
+        auto* vm = RE::BSScript::Internal::VirtualMachine::GetSingleton();
+        if (!vm || !quest) return nullptr;
+        if (!handle) handle = GetQuestHandle(vm, quest);
+        if (!handle || !vm->FindBoundObject(handle, scriptName, script)) script = nullptr;
+        return script;
+    }
+
+    // Called once at kDataLoaded
+    void ResolveScriptCache() {
+        auto dataHandler = RE::TESDataHandler::GetSingleton();
+        if (!dataHandler) {
+            logger::error("!!! ResolveScriptCache: TESDataHandler is null!");
             return;
         }
-        PreviousSentEvent = msg;
+        std::scoped_lock lock(s_scriptCacheLock);
+        s_scriptCache.interfaceQuest = dataHandler->LookupForm<RE::TESQuest>(0x03D41A, "Mantella.esp");
+        s_scriptCache.repositoryQuest = dataHandler->LookupForm<RE::TESQuest>(0xD62, "Mantella.esp");
+        if (!s_scriptCache.interfaceQuest) logger::error("!!! ResolveScriptCache: MantellaInterface quest not found");
+        if (!s_scriptCache.repositoryQuest) logger::error("!!! ResolveScriptCache: MantellaRepository quest not found");
+        ResolveScript(s_scriptCache.interfaceQuest, "MantellaInterface", s_scriptCache.interfaceHandle,
+                      s_scriptCache.interfaceScript);
+        ResolveScript(s_scriptCache.repositoryQuest, "MantellaRepository", s_scriptCache.repositoryHandle,
+                      s_scriptCache.repositoryScript);
+    }
+
+    // Drops everything that belongs to the current VM state. The quest forms themselves stay valid.
+    void InvalidateScriptCache() {
+        std::scoped_lock lock(s_scriptCacheLock);
+        s_scriptCache.interfaceHandle = 0;
+        s_scriptCache.repositoryHandle = 0;
+        s_scriptCache.interfaceScript = nullptr;
+        s_scriptCache.repositoryScript = nullptr;
+        s_scriptCache.interfaceHasAddEvents.reset();
+        logger::info("ScriptCache: Invalidated ({} hits, {} misses so far)",
+                     s_scriptCacheHits.load(std::memory_order_relaxed),
+                     s_scriptCacheMisses.load(std::memory_order_relaxed));
+    }
+
+    RE::BSTSmartPointer<RE::BSScript::Object> GetMantellaInterfaceScript() {
+        std::scoped_lock lock(s_scriptCacheLock);
+        return ResolveScript(s_scriptCache.interfaceQuest, "MantellaInterface", s_scriptCache.interfaceHandle,
+                             s_scriptCache.interfaceScript);
+    }
+
+    RE::BSTSmartPointer<RE::BSScript::Object> GetMantellaRepositoryScript() {
+        std::scoped_lock lock(s_scriptCacheLock);
+        return ResolveScript(s_scriptCache.repositoryQuest, "MantellaRepository", s_scriptCache.repositoryHandle,
+                             s_scriptCache.repositoryScript);
+    }
+
+    // Returns true if the event was sent recently, otherwise remembers it as sent
+    bool IsDuplicateEvent(std::string_view msg) {
+        if (!s_sentEvents.CheckAndRecord(msg)) return false;
+        logger::debug("Skipping duplicate event ({} skipped so far): {}", s_sentEvents.SkippedCount(), msg);
+        return true;
+    }
+
+    void AddMantellaEvent(std::string msg, bool deduplicate = true) {
+        if (deduplicate && IsDuplicateEvent(msg)) return;
 
         auto targetFunction = "AddMantellaEvent";
         auto* vm = RE::BSScript::Internal::VirtualMachine::GetSingleton();
-        auto mantellaQuest = RE::TESDataHandler::GetSingleton()->LookupForm<RE::TESQuest>(0x03D41A, "Mantella.esp");
-        auto questHandle = vm->GetObjectHandlePolicy()->GetHandleForObject(mantellaQuest->GetFormType(), mantellaQuest);
         RE::BSTSmartPointer<RE::BSScript::IStackCallbackFunctor> callback;
-        RE::BSTSmartPointer<RE::BSScript::Object> script = nullptr;
-        if (vm->FindBoundObject(questHandle, "MantellaInterface", script)) {
+        if (auto script = GetMantellaInterfaceScript()) {
             auto args = RE::MakeFunctionArguments(std::move(msg));
             vm->DispatchMethodCall1(script, targetFunction, args, callback);
         } else {
@@ -25,18 +119,63 @@ namespace MantellaPapyrusInterface {
         }
     }
 
-    RE::VMHandle GetMantellaRepositoryHandle() {
+    // Whether the script's type has a member function `name`, looked up once per VM state
+    static bool HasMemberFunction(const RE::BSTSmartPointer<RE::BSScript::Object>& script, std::string_view name) {
+        auto* typeInfo = script ? script->GetTypeInfo() : nullptr;
+        if (!typeInfo) return false;
+        const auto* functions = typeInfo->GetMemberFuncIter();
+        for (std::uint32_t i = 0; functions && i < typeInfo->GetNumMemberFuncs(); ++i)
+            if (functions[i].func && std::string_view(functions[i].func->GetName().c_str()) == name) return true;
+        return false;
+    }
+
+    static bool SupportsAddMantellaEvents(const RE::BSTSmartPointer<RE::BSScript::Object>& script) {
+        std::scoped_lock lock(s_scriptCacheLock);
+        if (!s_scriptCache.interfaceHasAddEvents) {
+            s_scriptCache.interfaceHasAddEvents = HasMemberFunction(script, "AddMantellaEvents");
+            if (!*s_scriptCache.interfaceHasAddEvents)
+                logger::info("MantellaInterface has no AddMantellaEvents, batched events are sent one by one");
+        }
+        return *s_scriptCache.interfaceHasAddEvents;
+    }
+
+    // -------------------------------------------------------------------------
+    // Sends several events with a single Papyrus call: as a string[] to
+    // AddMantellaEvents when the installed Mantella scripts have it,
+    // otherwise one AddMantellaEvent per event, so none of them grows past
+    // the size the dispatchers cut their batches to. Duplicates are skipped
+    // per event, like AddMantellaEvent does.
+    // -------------------------------------------------------------------------
+    void AddMantellaEvents(std::vector<std::string> msgs, bool deduplicate = true) {
+        if (deduplicate) std::erase_if(msgs, [](const std::string& msg) { return IsDuplicateEvent(msg); });
+        if (msgs.empty()) return;
+        if (msgs.size() == 1) {
+            AddMantellaEvent(std::move(msgs.front()), false);
+            return;
+        }
+        auto script = GetMantellaInterfaceScript();
+        if (!script) {
+            logger::error("!!! Failed to find MantellaInterface script");
+            return;
+        }
+        if (!SupportsAddMantellaEvents(script)) {
+            for (auto& msg : msgs) AddMantellaEvent(std::move(msg), false);
+            return;
+        }
         auto* vm = RE::BSScript::Internal::VirtualMachine::GetSingleton();
-        auto mantellaQuest = RE::TESDataHandler::GetSingleton()->LookupForm<RE::TESQuest>(0xD62, "Mantella.esp");
-        auto questHandle = vm->GetObjectHandlePolicy()->GetHandleForObject(mantellaQuest->GetFormType(), mantellaQuest);
-        return questHandle;
+        RE::BSTSmartPointer<RE::BSScript::IStackCallbackFunctor> callback;
+        auto args = RE::MakeFunctionArguments(std::move(msgs));
+        vm->DispatchMethodCall1(script, "AddMantellaEvents", args, callback);
+    }
+
+    RE::VMHandle GetMantellaRepositoryHandle() {
+        GetMantellaRepositoryScript();
+        std::scoped_lock lock(s_scriptCacheLock);
+        return s_scriptCache.repositoryHandle;
     }
 
     bool GetMantellaMcmSetting(std::string propertyName, RE::BSScript::Variable& a_getVal) {
-        auto questHandle = GetMantellaRepositoryHandle();
-        auto* vm = RE::BSScript::Internal::VirtualMachine::GetSingleton();
-        RE::BSTSmartPointer<RE::BSScript::Object> script = nullptr;
-        if (vm->FindBoundObject(questHandle, "MantellaRepository", script)) {
+        if (auto script = GetMantellaRepositoryScript()) {
             auto propertyPointer = script->GetProperty(propertyName);
             if (!propertyPointer) {
                 logger::error("!!! Failed to get Mantella setting {}", propertyName);
@@ -71,4 +210,28 @@ namespace MantellaPapyrusInterface {
         return -1;
     }
 
+    // -------------------------------------------------------------------------
+    // McmSettings:
+    // Immutable snapshot of the MCM values the plugin needs. It is re-read from
+    // Papyrus only on game load, conversation start and notifySettingsChanged, so
+    // the subtitle hook just does one atomic load instead of a property lookup.
+    // -------------------------------------------------------------------------
+    struct McmSettings {
+        bool enableVanillaDialogueAwareness = true;
+        int httpPort = -1;
+    };
+
+    static inline std::atomic<std::shared_ptr<const McmSettings>> s_mcmSettings{std::make_shared<const McmSettings>()};
+
+    std::shared_ptr<const McmSettings> GetMcmSettings() { return s_mcmSettings.load(std::memory_order_acquire); }
+
+    void RefreshMcmSettings() {
+        auto settings = std::make_shared<McmSettings>();
+        settings->enableVanillaDialogueAwareness = GetMantellaEnableVanillaDialogueAwareness();
+        settings->httpPort = GetMantellaServerPort();
+        logger::debug("RefreshMcmSettings: enableVanillaDialogueAwareness={}, HttpPort={}",
+                      settings->enableVanillaDialogueAwareness, settings->httpPort);
+        s_mcmSettings.store(std::move(settings), std::memory_order_release);
+    }
+
 }
@@ -30,11 +30,13 @@ namespace stl
 {
     using namespace SKSE::stl;
 
+    // Needs kThunkCallSize bytes of trampoline per call, allocated up front for all of them with SKSE::AllocTrampoline
+    constexpr std::size_t kThunkCallSize = 14;
+
     template <class T>
     void write_thunk_call(std::uintptr_t a_src)
     {
         auto& trampoline = SKSE::GetTrampoline();
-        SKSE::AllocTrampoline(64);
         T::func = trampoline.write_call<5>(a_src, T::thunk);
     }
 }
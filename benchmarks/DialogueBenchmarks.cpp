@@ -0,0 +1,638 @@
+// -----------------------------------------------------------------------------
+// Offline benchmarks of the dialogue pipeline. Replays a recorded subtitle
+// trace (--trace=<MantellaDialogue.journal or .log>) or, without one, a synthetic trace
+// through the game-independent parts of the ShowSubtitle hook.
+// Besides time, every benchmark reports heap allocations per iteration;
+// BM_ReplayTrace also reports the p99 latency of a single exchange.
+// BM_SaveFormat / BM_LoadFormat don't use the trace: they run every co-save
+// format over a grid of synthetic backlogs, for comparing releases.
+// -----------------------------------------------------------------------------
+#include <benchmark/benchmark.h>
+
+#include <algorithm>  // For std::sort
+#include <atomic>     // For std::atomic
+#include <chrono>     // For std::chrono::steady_clock
+#include <cstdint>    // For fixed-width integer types
+#include <cstddef>    // For std::byte, std::max_align_t
+#include <cstdlib>    // For std::malloc, std::free
+#include <cstring>    // For std::memcpy
+#include <map>        // For std::map
+#include <mutex>      // For std::mutex
+#include <new>        // For std::bad_alloc
+#include <string>     // For std::string
+#include <utility>    // For std::pair
+#include <vector>     // For std::vector
+
+#include "DialogueTrace.h"
+#include "MantellaDialogueBacklog.h"
+#include "MantellaDialogueCompression.h"
+#include "MantellaDialogueDedup.h"
+#include "MantellaDialogueFormat.h"
+#include "MantellaDialogueIniConfig.h"
+#include "MantellaDialogueLine.h"
+#include "MantellaDialogueRules.h"
+#include "MantellaDialogueSerialization.h"
+#include "MantellaDialogueSnapshot.h"
+#include "MantellaNamePool.h"
+
+// Every allocation of the process is counted, benchmarks report the difference per iteration. Each block starts
+// with its size, so the bytes in use and their high-water mark are known too.
+static std::atomic<std::uint64_t> s_allocations = 0;
+static std::atomic<std::uint64_t> s_heapBytes = 0;
+static std::atomic<std::uint64_t> s_heapPeak = 0;
+static constexpr std::size_t kBlockHeader = alignof(std::max_align_t);
+
+void* operator new(std::size_t size) {
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    auto* block = static_cast<std::byte*>(std::malloc(size + kBlockHeader));
+    if (!block) throw std::bad_alloc();
+    std::memcpy(block, &size, sizeof(size));
+    const auto inUse = s_heapBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    auto peak = s_heapPeak.load(std::memory_order_relaxed);
+    while (peak < inUse && !s_heapPeak.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {
+    }
+    return block + kBlockHeader;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    auto* block = static_cast<std::byte*>(p) - kBlockHeader;
+    std::size_t size = 0;
+    std::memcpy(&size, block, sizeof(size));
+    s_heapBytes.fetch_sub(size, std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+namespace {
+
+    using MantellaDialogueBacklog::DialogueBacklog;
+
+    std::vector<DialogueTrace::Exchange> s_trace;
+
+    // Counts allocations from construction until Report()
+    class AllocationCounter {
+    public:
+        AllocationCounter() : m_start(s_allocations.load(std::memory_order_relaxed)) {}
+
+        void Report(benchmark::State& state) const {
+            state.counters["allocs"] = benchmark::Counter(
+                static_cast<double>(s_allocations.load(std::memory_order_relaxed) - m_start),
+                benchmark::Counter::kAvgIterations);
+        }
+
+    private:
+        std::uint64_t m_start;
+    };
+
+    // Most heap in use at once from construction until Report(), above what was in use before
+    class HeapPeak {
+    public:
+        HeapPeak() : m_start(s_heapBytes.load(std::memory_order_relaxed)) {
+            s_heapPeak.store(m_start, std::memory_order_relaxed);
+        }
+
+        void Report(benchmark::State& state) const {
+            state.counters["peak_heap"] = static_cast<double>(s_heapPeak.load(std::memory_order_relaxed) - m_start);
+        }
+
+    private:
+        std::uint64_t m_start;
+    };
+
+    std::size_t TraceBytes() {
+        std::size_t bytes = 0;
+        for (const auto& exchange : s_trace) bytes += exchange.playerLine.size() + exchange.npcLine.size();
+        return bytes;
+    }
+
+    Hooks::DialogueLine ToLine(const DialogueTrace::Exchange& exchange, float gameTimeHours) {
+        return {exchange.playerLine, MantellaNamePool::Intern(exchange.playerName), exchange.npcLine,
+                MantellaNamePool::Intern(exchange.npcName), gameTimeHours,
+                exchange.sayOnce ? Hooks::kLineSayOnce : 0u};
+    }
+
+    DialogueBacklog FillBacklog() {
+        DialogueBacklog backlog(
+            static_cast<std::size_t>(MantellaDialogueIniConfig::current()->MaxDialogueLinesPerActor));
+        float gameTimeHours = 0.0f;
+        for (const auto& exchange : s_trace) backlog.Push(exchange.formID, ToLine(exchange, gameTimeHours += 0.01f));
+        return backlog;
+    }
+
+    // Serialization interface stand-in that collects the record in memory, and reads it back like a load does
+    struct MemoryRecord {
+        std::string data;
+        std::size_t readPos = 0;
+
+        bool WriteRecordData(const void* buffer, std::uint32_t length) {
+            data.append(static_cast<const char*>(buffer), length);
+            return true;
+        }
+
+        std::uint32_t ReadRecordData(void* buffer, std::uint32_t length) {
+            const auto n = static_cast<std::uint32_t>(std::min<std::size_t>(length, data.size() - readPos));
+            std::memcpy(buffer, data.data() + readPos, n);
+            readPos += n;
+            return n;
+        }
+    };
+
+    // The filter rules of ShouldFilterDialoge
+    void BM_Classify(benchmark::State& state) {
+        const auto& config = *MantellaDialogueIniConfig::current();
+        AllocationCounter allocations;
+        for (auto _ : state)
+            for (const auto& exchange : s_trace)
+                benchmark::DoNotOptimize(MantellaDialogueRules::Classify(config, exchange.playerLine, exchange.npcLine,
+                                                                         exchange.sayOnce));
+        allocations.Report(state);
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * s_trace.size()));
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * TraceBytes()));
+    }
+
+    // The same rules behind the hook's VerdictCache. The trace has no topic infos, every distinct exchange
+    // stands in for one. After the first iteration each subtitle is a cache hit, like a bark heard again.
+    void BM_ClassifyCached(benchmark::State& state) {
+        const auto& config = *MantellaDialogueIniConfig::current();
+        std::map<std::pair<std::string, std::string>, std::uint32_t> topicIDs;
+        std::vector<std::uint32_t> topicInfo;
+        topicInfo.reserve(s_trace.size());
+        for (const auto& exchange : s_trace)
+            topicInfo.push_back(topicIDs.try_emplace({exchange.playerLine, exchange.npcLine},
+                                                     static_cast<std::uint32_t>(topicIDs.size()))
+                                    .first->second);
+        MantellaDialogueRules::VerdictCache cache;
+        AllocationCounter allocations;
+        for (auto _ : state)
+            for (std::size_t i = 0; i < s_trace.size(); ++i) {
+                const auto& exchange = s_trace[i];
+                if (auto cached = cache.Find(topicInfo[i], exchange.playerLine, exchange.npcLine, config.generation)) {
+                    benchmark::DoNotOptimize(cached->reason);
+                    continue;
+                }
+                const MantellaDialogueRules::TopicVerdict verdict{
+                    MantellaDialogueRules::Classify(config, exchange.playerLine, exchange.npcLine, exchange.sayOnce),
+                    exchange.sayOnce ? Hooks::kLineSayOnce : 0u};
+                cache.Store(topicInfo[i], exchange.playerLine, exchange.npcLine, verdict);
+            }
+        allocations.Report(state);
+        state.counters["topics"] = static_cast<double>(topicIDs.size());
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * s_trace.size()));
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * TraceBytes()));
+    }
+
+    // What the hook does per subtitle once it has the text: filter, build the line, store it
+    void BM_ReplayTrace(benchmark::State& state) {
+        const auto& config = *MantellaDialogueIniConfig::current();
+        std::vector<std::int64_t> latencies;
+        latencies.reserve(s_trace.size());
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            state.PauseTiming();
+            DialogueBacklog backlog(static_cast<std::size_t>(config.MaxDialogueLinesPerActor));
+            latencies.clear();
+            state.ResumeTiming();
+            float gameTimeHours = 0.0f;
+            for (const auto& exchange : s_trace) {
+                const auto start = std::chrono::steady_clock::now();
+                if (MantellaDialogueRules::Classify(config, exchange.playerLine, exchange.npcLine, exchange.sayOnce) ==
+                    MantellaDialogueRules::FilterReason::None)
+                    backlog.Push(exchange.formID, ToLine(exchange, gameTimeHours += 0.01f));
+                latencies.push_back((std::chrono::steady_clock::now() - start).count());
+            }
+            benchmark::DoNotOptimize(backlog.LineCount());
+        }
+        allocations.Report(state);
+        if (!latencies.empty()) {
+            std::sort(latencies.begin(), latencies.end());
+            const auto p99 = latencies[latencies.size() * 99 / 100];
+            state.counters["p99_ns"] = static_cast<double>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::duration(p99)).count());
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * s_trace.size()));
+    }
+
+    // The history concat sent when an actor joins a conversation
+    void BM_FormatReplay(benchmark::State& state) {
+        const auto backlog = FillBacklog();
+        std::size_t bytes = 0;
+        AllocationCounter allocations;
+        for (auto _ : state)
+            backlog.ForEachActor([&](const MantellaDialogueBacklog::ActorRing& actor) {
+                auto text = MantellaDialogueFormat::FormatReplay(actor);
+                bytes += text.size();
+                benchmark::DoNotOptimize(text);
+            });
+        allocations.Report(state);
+        state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+    }
+
+    // The same with a ReplayBudgetChars of state.range(0): ranking, then formatting the chosen lines
+    void BM_FormatReplayBudget(benchmark::State& state) {
+        const auto backlog = FillBacklog();
+        const auto budget = static_cast<std::size_t>(state.range(0));
+        std::size_t bytes = 0;
+        AllocationCounter allocations;
+        for (auto _ : state)
+            backlog.ForEachActor([&](const MantellaDialogueBacklog::ActorRing& actor) {
+                const auto choices = MantellaDialogueFormat::SelectReplay(actor, budget);
+                auto text = MantellaDialogueFormat::FormatReplay(actor, choices);
+                bytes += text.size();
+                benchmark::DoNotOptimize(text);
+            });
+        allocations.Report(state);
+        state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+    }
+
+    void BM_DedupWindow(benchmark::State& state) {
+        MantellaDialogueDedup::DedupWindow window(static_cast<std::size_t>(state.range(0)));
+        for (auto _ : state)
+            for (const auto& exchange : s_trace) benchmark::DoNotOptimize(window.CheckAndRecord(exchange.npcLine));
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * s_trace.size()));
+    }
+
+    // Every actor changed, nothing can come from the segment cache
+    void BM_SaveBinary(benchmark::State& state) {
+        auto backlog = FillBacklog();
+        std::size_t size = 0;
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            state.PauseTiming();
+            backlog.InvalidateSegments();
+            state.ResumeTiming();
+            MemoryRecord record;
+            MantellaDialogueSerialization::WriteStats stats;
+            MantellaDialogueSerialization::WriteDialogueHistory(&record, backlog, &stats);
+            if (stats.actorsEncoded != backlog.ActorCount()) {
+                state.SkipWithError("cached segments were reused, this is not a full save");
+                break;
+            }
+            size = record.data.size();
+            benchmark::DoNotOptimize(record.data);
+        }
+        allocations.Report(state);
+        state.counters["record_bytes"] = static_cast<double>(size);
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * size));
+    }
+
+    // A quicksave after one new line: a single actor is encoded again
+    void BM_SaveBinaryAfterNewLine(benchmark::State& state) {
+        auto backlog = FillBacklog();
+        std::size_t size = 0, next = 0;
+        float gameTimeHours = 1000.0f;
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            state.PauseTiming();
+            const auto& exchange = s_trace[next++ % s_trace.size()];
+            backlog.Push(exchange.formID, ToLine(exchange, gameTimeHours += 0.01f));
+            state.ResumeTiming();
+            MemoryRecord record;
+            MantellaDialogueSerialization::WriteDialogueHistory(&record, backlog);
+            size = record.data.size();
+            benchmark::DoNotOptimize(record.data);
+        }
+        allocations.Report(state);
+        state.counters["record_bytes"] = static_cast<double>(size);
+    }
+
+    // What the save callback does when the background snapshot is current: copy its bytes into the record
+    void BM_SaveFromSnapshot(benchmark::State& state) {
+        auto backlog = FillBacklog();
+        std::mutex lock;
+        MantellaDialogueSnapshot::SnapshotEncoder encoder(backlog, lock);
+        encoder.Update();
+        const auto snapshot = encoder.Current();
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            MemoryRecord record;
+            MantellaDialogueSnapshot::WriteSnapshot(&record, *snapshot);
+            benchmark::DoNotOptimize(record.data);
+        }
+        allocations.Report(state);
+        state.counters["record_bytes"] = static_cast<double>(snapshot->Bytes());
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * snapshot->Bytes()));
+    }
+
+    void BM_LoadBinary(benchmark::State& state) {
+        MemoryRecord record;
+        MantellaDialogueSerialization::WriteDialogueHistory(&record, FillBacklog());
+        DialogueBacklog backlog(
+            static_cast<std::size_t>(MantellaDialogueIniConfig::current()->MaxDialogueLinesPerActor));
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            if (!MantellaDialogueSerialization::ReadDialogueHistory(record.data, backlog)) {
+                state.SkipWithError("'HIS2' record did not round-trip");
+                break;
+            }
+            benchmark::DoNotOptimize(backlog.LineCount());
+        }
+        allocations.Report(state);
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * record.data.size()));
+    }
+
+    // Loading and then looking up every actor, what BM_LoadBinary cost before actors were decoded lazily
+    void BM_LoadBinaryDecodeAll(benchmark::State& state) {
+        MemoryRecord record;
+        MantellaDialogueSerialization::WriteDialogueHistory(&record, FillBacklog());
+        DialogueBacklog backlog(
+            static_cast<std::size_t>(MantellaDialogueIniConfig::current()->MaxDialogueLinesPerActor));
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            if (!MantellaDialogueSerialization::ReadDialogueHistory(record.data, backlog)) {
+                state.SkipWithError("'HIS2' record did not round-trip");
+                break;
+            }
+            backlog.DecodeAll();
+            benchmark::DoNotOptimize(backlog.LiveTextBytes());
+        }
+        allocations.Report(state);
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * record.data.size()));
+    }
+
+    // 'HIS2' v2 at the default level, every actor encoded again like BM_SaveBinary
+    void BM_SaveCompressed(benchmark::State& state) {
+        auto backlog = FillBacklog();
+        std::size_t size = 0, payloadSize = 0;
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            state.PauseTiming();
+            backlog.InvalidateSegments();
+            state.ResumeTiming();
+            MemoryRecord record;
+            MantellaDialogueCompression::CompressingRecord compressor(&record, static_cast<int>(state.range(0)));
+            MantellaDialogueSerialization::WriteStats stats;
+            MantellaDialogueSerialization::WriteDialogueHistory(&compressor, backlog, &stats);
+            compressor.Finish();
+            if (stats.actorsEncoded != backlog.ActorCount()) {
+                state.SkipWithError("cached segments were reused, this is not a full save");
+                break;
+            }
+            size = record.data.size();
+            payloadSize = compressor.BytesIn();
+            benchmark::DoNotOptimize(record.data);
+        }
+        allocations.Report(state);
+        state.counters["record_bytes"] = static_cast<double>(size);
+        state.counters["ratio"] = static_cast<double>(payloadSize) / static_cast<double>(size);
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * payloadSize));
+    }
+
+    void BM_LoadCompressed(benchmark::State& state) {
+        MemoryRecord record;
+        {
+            MantellaDialogueCompression::CompressingRecord compressor(&record, 3);
+            MantellaDialogueSerialization::WriteDialogueHistory(&compressor, FillBacklog());
+            compressor.Finish();
+        }
+        DialogueBacklog backlog(
+            static_cast<std::size_t>(MantellaDialogueIniConfig::current()->MaxDialogueLinesPerActor));
+        std::string scratch;
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            std::string_view payload;
+            if (!MantellaDialogueCompression::DecodeRecord(record.data, scratch, payload) ||
+                !MantellaDialogueSerialization::ReadDialogueHistory(payload, backlog)) {
+                state.SkipWithError("compressed 'HIS2' record did not round-trip");
+                break;
+            }
+            benchmark::DoNotOptimize(backlog.LineCount());
+        }
+        allocations.Report(state);
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * record.data.size()));
+    }
+
+    // The JSON 'HIST' layout older versions saved, still read when migrating a co-save
+    nlohmann::json ToLegacyJson(const DialogueBacklog& backlog) {
+        nlohmann::json j = nlohmann::json::object();
+        backlog.ForEachActor([&](const MantellaDialogueBacklog::ActorRing& actor) {
+            std::vector<Hooks::DialogueLine> lines;
+            actor.ForEach([&](const MantellaDialogueBacklog::LineView& line) { lines.push_back(line.ToLine()); });
+            j[std::to_string(actor.GetFormID())] = lines;
+        });
+        return j;
+    }
+
+    void BM_SaveJson(benchmark::State& state) {
+        const auto backlog = FillBacklog();
+        std::size_t size = 0;
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            auto text = ToLegacyJson(backlog).dump();
+            size = text.size();
+            benchmark::DoNotOptimize(text);
+        }
+        allocations.Report(state);
+        state.counters["record_bytes"] = static_cast<double>(size);
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * size));
+    }
+
+    void BM_LoadJson(benchmark::State& state) {
+        const auto text = ToLegacyJson(FillBacklog()).dump();
+        DialogueBacklog backlog(
+            static_cast<std::size_t>(MantellaDialogueIniConfig::current()->MaxDialogueLinesPerActor));
+        AllocationCounter allocations;
+        for (auto _ : state) {
+            backlog.Clear();
+            const auto j = nlohmann::json::parse(text);
+            for (auto it = j.begin(); it != j.end(); ++it) {
+                const auto formID = static_cast<MantellaDialogueBacklog::FormID>(std::stoul(it.key()));
+                for (const auto& line : it.value().get<std::vector<Hooks::DialogueLine>>()) backlog.Push(formID, line);
+            }
+            benchmark::DoNotOptimize(backlog.LineCount());
+        }
+        allocations.Report(state);
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * text.size()));
+    }
+
+    // -------------------------------------------------------------------------
+    // Save and load of every co-save format over synthetic backlogs of
+    // state.range(0) lines spread over state.range(1) actors, with the line
+    // lengths of DialogueTrace::Synthetic. Lines are never evicted, the
+    // dataset is the whole backlog. Next to the time, each reports
+    // record_bytes and peak_heap, the most heap the save or load had in use.
+    // -------------------------------------------------------------------------
+    enum RecordFormat : std::int64_t {
+        kFormatBinary = 0,      // 'HIS2' with kCodecNone
+        kFormatCompressed = 1,  // 'HIS2' with kCodecZstdDict1 at the default level
+        kFormatJson = 2,        // the legacy 'HIST' JSON
+    };
+
+    constexpr const char* kRecordFormatNames[] = {"binary", "zstd", "json"};
+
+    constexpr std::size_t kGridMaxActors = 2000;  // the most actors RecordFormatGrid asks for
+
+    DialogueBacklog SyntheticBacklog(std::size_t lines, std::size_t actors) {
+        // The name pool never shrinks and is part of every record. Filled with the names of the largest dataset up
+        // front, each grid point sees the same pool whichever benchmarks ran before.
+        [[maybe_unused]] static const bool namesInterned = []() {
+            for (std::size_t actor = 0; actor < kGridMaxActors; ++actor)
+                MantellaNamePool::Intern("NPC " + std::to_string(actor));  // DialogueTrace::Synthetic's names
+            return true;
+        }();
+        DialogueBacklog backlog(lines);
+        float gameTimeHours = 0.0f;
+        for (const auto& exchange : DialogueTrace::Synthetic(lines, actors))
+            backlog.Push(exchange.formID, ToLine(exchange, gameTimeHours += 0.01f));
+        return backlog;
+    }
+
+    // What MySaveCallback writes into the record when there is no current snapshot. JSON encodes every actor.
+    bool SaveRecord(RecordFormat format, const DialogueBacklog& backlog, MemoryRecord& record,
+                    MantellaDialogueSerialization::WriteStats* stats = nullptr) {
+        if (format == kFormatJson) {
+            const auto text = ToLegacyJson(backlog).dump();
+            if (stats) *stats = {backlog.ActorCount(), text.size()};
+            return record.WriteRecordData(text.data(), static_cast<std::uint32_t>(text.size()));
+        }
+        if (format == kFormatCompressed) {
+            MantellaDialogueCompression::CompressingRecord compressor(&record, 3);
+            return MantellaDialogueSerialization::WriteDialogueHistory(&compressor, backlog, stats) &&
+                   compressor.Finish();
+        }
+        return MantellaDialogueCompression::WriteUncompressedHeader(&record) &&
+               MantellaDialogueSerialization::WriteDialogueHistory(&record, backlog, stats);
+    }
+
+    // What MyLoadCallback does with the record, and then, for the binary formats, what the lazy decode does once
+    // every actor was looked up. Every format ends with all lines in the backlog, like the JSON load does.
+    bool LoadRecord(RecordFormat format, MemoryRecord& record, DialogueBacklog& backlog) {
+        record.readPos = 0;
+        std::string data(record.data.size(), '\0');
+        if (record.ReadRecordData(data.data(), static_cast<std::uint32_t>(data.size())) != data.size()) return false;
+        if (format == kFormatJson) {
+            backlog.Clear();
+            const auto j = nlohmann::json::parse(data);
+            for (auto it = j.begin(); it != j.end(); ++it) {
+                const auto formID = static_cast<MantellaDialogueBacklog::FormID>(std::stoul(it.key()));
+                for (const auto& line : it.value().get<std::vector<Hooks::DialogueLine>>()) backlog.Push(formID, line);
+            }
+            return true;
+        }
+        std::string decompressed;
+        std::string_view payload;
+        if (!MantellaDialogueCompression::DecodeRecord(data, decompressed, payload) ||
+            !MantellaDialogueSerialization::ReadDialogueHistory(payload, backlog))
+            return false;
+        backlog.DecodeAll();  // BM_LoadBinary has the lazy load alone
+        return true;
+    }
+
+    void BM_SaveFormat(benchmark::State& state) {
+        const auto lines = static_cast<std::size_t>(state.range(0));
+        const auto format = static_cast<RecordFormat>(state.range(2));
+        auto backlog = SyntheticBacklog(lines, static_cast<std::size_t>(state.range(1)));
+        state.SetLabel(kRecordFormatNames[format]);
+        std::size_t size = 0;
+        AllocationCounter allocations;
+        HeapPeak heap;
+        for (auto _ : state) {
+            state.PauseTiming();
+            backlog.InvalidateSegments();  // a full save in every format, no cached segments
+            state.ResumeTiming();
+            MemoryRecord record;
+            MantellaDialogueSerialization::WriteStats stats;
+            if (!SaveRecord(format, backlog, record, &stats)) {
+                state.SkipWithError("record could not be written");
+                break;
+            }
+            if (stats.actorsEncoded != backlog.ActorCount()) {
+                state.SkipWithError("cached segments were reused, this is not a full save");
+                break;
+            }
+            size = record.data.size();
+            benchmark::DoNotOptimize(record.data);
+        }
+        allocations.Report(state);
+        heap.Report(state);
+        state.counters["record_bytes"] = static_cast<double>(size);
+        state.counters["bytes_per_line"] = static_cast<double>(size) / static_cast<double>(lines);
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * lines));
+    }
+
+    void BM_LoadFormat(benchmark::State& state) {
+        const auto lines = static_cast<std::size_t>(state.range(0));
+        const auto format = static_cast<RecordFormat>(state.range(2));
+        MemoryRecord record;
+        SaveRecord(format, SyntheticBacklog(lines, static_cast<std::size_t>(state.range(1))), record);
+        state.SetLabel(kRecordFormatNames[format]);
+        DialogueBacklog backlog(lines);
+        AllocationCounter allocations;
+        HeapPeak heap;
+        for (auto _ : state) {
+            if (!LoadRecord(format, record, backlog) || backlog.LineCount() != lines) {
+                state.SkipWithError("record did not round-trip");
+                break;
+            }
+            benchmark::DoNotOptimize(backlog.LineCount());
+        }
+        allocations.Report(state);
+        heap.Report(state);
+        state.counters["record_bytes"] = static_cast<double>(record.data.size());
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * lines));
+    }
+
+    // From a handful of lines up to the MAX_DIALOGUE_LINES cutoff, over 1 to 2000 actors (never more than lines)
+    void RecordFormatGrid(benchmark::internal::Benchmark* b) {
+        for (std::int64_t format : {kFormatBinary, kFormatCompressed, kFormatJson})
+            for (std::int64_t lines : {10, 200, 2000, 20000})
+                for (std::int64_t actors : {1, 20, 200, 2000})
+                    if (actors <= lines) b->Args({lines, actors, format});
+        b->ArgNames({"lines", "actors", "format"});
+    }
+
+}
+
+BENCHMARK(BM_Classify);
+BENCHMARK(BM_ClassifyCached);
+BENCHMARK(BM_ReplayTrace);
+BENCHMARK(BM_FormatReplay);
+BENCHMARK(BM_FormatReplayBudget)->Arg(1000)->Arg(4000);
+BENCHMARK(BM_DedupWindow)->Arg(16)->Arg(256);
+BENCHMARK(BM_SaveBinary);
+BENCHMARK(BM_SaveBinaryAfterNewLine);
+BENCHMARK(BM_SaveFromSnapshot);
+BENCHMARK(BM_LoadBinary);
+BENCHMARK(BM_LoadBinaryDecodeAll);
+BENCHMARK(BM_SaveCompressed)->Arg(1)->Arg(3)->Arg(9);
+BENCHMARK(BM_LoadCompressed);
+BENCHMARK(BM_SaveJson);
+BENCHMARK(BM_LoadJson);
+BENCHMARK(BM_SaveFormat)->Apply(RecordFormatGrid);
+BENCHMARK(BM_LoadFormat)->Apply(RecordFormatGrid);
+
+// Extra flags, handled before Google Benchmark sees the command line:
+//   --trace=<path>   replay this MantellaDialogue.journal / .log instead of the synthetic trace
+//   --ini=<path>     filter with this MantellaDialogue.ini instead of the defaults
+int main(int argc, char** argv) {
+    std::string tracePath, iniPath;
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--trace=")) tracePath = arg.substr(8);
+        else if (arg.starts_with("--ini=")) iniPath = arg.substr(6);
+        else argv[kept++] = argv[i];
+    }
+    argc = kept;
+
+    // Without --ini the defaults are wanted, don't complain about the missing file
+    SetLogLevel(iniPath.empty() ? spdlog::level::off : spdlog::level::err);
+    MantellaDialogueIniConfig::loadConfiguration(iniPath);
+    SetLogLevel(spdlog::level::info);
+    if (!tracePath.empty()) {
+        s_trace = DialogueTrace::Load(tracePath);
+        if (s_trace.empty()) {
+            spdlog::error("No exchanges found in {}", tracePath);
+            return 1;
+        }
+    } else
+        s_trace = DialogueTrace::Synthetic(5000, 200);
+    spdlog::info("Replaying {} exchanges", s_trace.size());
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>        // For std::size_t
+#include <cstdint>        // For fixed-width integer types
+#include <filesystem>     // For std::filesystem::path
+#include <fstream>        // For std::ifstream
+#include <random>         // For std::mt19937
+#include <string>         // For std::string
+#include <string_view>    // For std::string_view
+#include <unordered_map>  // For std::unordered_map
+#include <vector>         // For std::vector
+
+#include "MantellaDialogueJournal.h"
+
+namespace DialogueTrace {
+
+    // One subtitle as the hook sees it
+    struct Exchange {
+        std::uint32_t formID = 0;
+        std::string playerName;
+        std::string playerLine;
+        std::string npcName;
+        std::string npcLine;
+        bool sayOnce = false;
+    };
+
+    // -------------------------------------------------------------------------
+    // Reads the exchanges of a MantellaDialogue.log. The hook logs every
+    // subtitle as two consecutive info lines, "(<player>): <topic>" followed by
+    // "(<npc>): <response>"; everything else in the log is skipped. The log has
+    // no FormIDs, so every distinct NPC name gets its own made-up one.
+    // -------------------------------------------------------------------------
+    inline std::vector<Exchange> ReadLog(const std::filesystem::path& path) {
+        std::vector<Exchange> trace;
+        std::ifstream file(path);
+        std::unordered_map<std::string, std::uint32_t> formIDs;
+        Exchange pending;
+        bool hasPlayerLine = false;
+        std::string line;
+        while (std::getline(file, line)) {
+            constexpr std::string_view kMarker = "[info] (";
+            const auto marker = line.find(kMarker);
+            const auto nameStart = marker + kMarker.size();
+            const auto nameEnd = marker == std::string::npos ? std::string::npos : line.find("): ", nameStart);
+            if (nameEnd == std::string::npos) {
+                hasPlayerLine = false;
+                continue;
+            }
+            auto name = line.substr(nameStart, nameEnd - nameStart);
+            auto text = line.substr(nameEnd + 3);
+            if (!hasPlayerLine) {
+                pending.playerName = std::move(name);
+                pending.playerLine = std::move(text);
+                hasPlayerLine = true;
+                continue;
+            }
+            pending.formID = formIDs.try_emplace(name, 0xFF000800u + static_cast<std::uint32_t>(formIDs.size()))
+                                 .first->second;
+            pending.npcName = std::move(name);
+            pending.npcLine = std::move(text);
+            trace.push_back(std::move(pending));
+            pending = {};
+            hasPlayerLine = false;
+        }
+        return trace;
+    }
+
+    // A journal recorded with EnableTraceCapture. It has no player name, the topic text is what the player said.
+    inline std::vector<Exchange> ReadJournal(std::string_view data) {
+        std::vector<Exchange> trace;
+        MantellaDialogueJournal::ForEachEvent(data, [&](const MantellaDialogueJournal::Event& event) {
+            Exchange exchange;
+            exchange.formID = event.speakerFormID;
+            exchange.playerName = "Player";
+            exchange.playerLine = event.topicText;
+            exchange.npcName = event.speakerName;
+            // Joined the way the hook builds npcLine
+            for (auto response : event.responses) {
+                if (response.empty()) continue;
+                if (!exchange.npcLine.empty()) exchange.npcLine.push_back(' ');
+                exchange.npcLine.append(response);
+            }
+            exchange.sayOnce = (event.recordFlags & MantellaDialogueJournal::kHasTopicInfo) &&
+                               (event.topicInfoFlags & MantellaDialogueJournal::kTopicInfoSayOnce);
+            trace.push_back(std::move(exchange));
+        });
+        return trace;
+    }
+
+    // Either kind of recording, told apart by the journal's magic
+    inline std::vector<Exchange> Load(const std::filesystem::path& path) {
+        const auto data = MantellaDialogueJournal::ReadFile(path);
+        if (MantellaDialogueJournal::IsJournal(data)) return ReadJournal(data);
+        return ReadLog(path);
+    }
+
+    // -------------------------------------------------------------------------
+    // Deterministic stand-in for a recorded trace, with roughly the mix a real
+    // play session has: mostly normal replies, some greetings, blacklisted
+    // lines and one or two word replies.
+    // -------------------------------------------------------------------------
+    inline std::vector<Exchange> Synthetic(std::size_t count, std::size_t actors, std::uint32_t seed = 0x4D544C44) {
+        static constexpr std::string_view kWords[] = {
+            "the",    "dragon", "Whiterun", "Jarl",   "sword", "you",     "have",   "I",      "never",
+            "seen",   "such",   "a",        "thing",  "gold",  "Skyrim",  "guard",  "arrow",  "knee",
+            "Talos",  "Nord",   "road",     "inn",    "mead",  "bandits", "north",  "should", "rest",
+            "travel", "safe",   "Dovahkiin", "Companions", "College", "Winterhold", "Thieves", "Guild"};
+        static constexpr std::string_view kTopics[] = {
+            "What can you tell me about this place?", "Any news?",       "I need your help.",
+            "Tell me about yourself.",                "What do you sell?", "Hello",
+            "I want you to..",                        "Stage1Hello",     "Where can I find the Jarl?"};
+
+        std::mt19937 rng(seed);
+        auto pick = [&](std::size_t n) { return static_cast<std::size_t>(rng() % n); };
+        auto sentence = [&](std::size_t minWords, std::size_t maxWords) {
+            std::string text;
+            const auto words = minWords + pick(maxWords - minWords + 1);
+            for (std::size_t i = 0; i < words; ++i) {
+                if (i) text.push_back(' ');
+                text.append(kWords[pick(std::size(kWords))]);
+            }
+            text.push_back('.');
+            return text;
+        };
+
+        std::vector<Exchange> trace;
+        trace.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            Exchange exchange;
+            const auto actor = pick(actors);
+            exchange.formID = 0x00013B00u + static_cast<std::uint32_t>(actor);
+            exchange.playerName = "Dragonborn";
+            exchange.npcName = "NPC " + std::to_string(actor);
+            exchange.playerLine = kTopics[pick(std::size(kTopics))];
+            const auto kind = pick(20);
+            if (kind == 0) exchange.npcLine = "Farewell";
+            else if (kind == 1) exchange.npcLine = "Hm?";
+            else exchange.npcLine = sentence(3, 40);
+            exchange.sayOnce = pick(4) == 0;
+            trace.push_back(std::move(exchange));
+        }
+        return trace;
+    }
+
+}
@@ -2,32 +2,59 @@
 
 // This is a snippet you can put at the top of all of your SKSE plugins!
 
+#if defined(MANTELLA_DIALOGUE_CORE)
+
+// Offline builds of the core (benchmarks) have no SKSE, they log straight to spdlog's default logger
+#include <spdlog/spdlog.h>
+
+namespace logger {
+    using spdlog::critical;
+    using spdlog::debug;
+    using spdlog::error;
+    using spdlog::info;
+    using spdlog::trace;
+    using spdlog::warn;
+}
+
+inline void SetLogLevel(spdlog::level::level_enum level) { spdlog::set_level(level); }
+
+#else
+
 #include <Windows.h>
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/msvc_sink.h>
 
 namespace logger = SKSE::log;
 
+// Messages waiting for the background writer. When full the oldest ones are dropped, the game never blocks on I/O.
+constexpr std::size_t kLogQueueSize = 8192;
+constexpr auto kLogFlushInterval = std::chrono::seconds(2);
+
 void SetupLog() {
     auto logsFolder = SKSE::log::log_directory();
     if (!logsFolder) SKSE::stl::report_and_fail("SKSE log_directory not provided, logs disabled.");
     auto pluginName = "MantellaDialogue";
     auto logFilePath = *logsFolder / std::format("{}.log", pluginName);
     auto fileLoggerPtr = std::make_shared<spdlog::sinks::basic_file_sink_mt>(logFilePath.string(), true);
-    std::shared_ptr<spdlog::logger> loggerPtr;
-    if (IsDebuggerPresent()) {
-        auto debugLoggerPtr = std::make_shared<spdlog::sinks::msvc_sink_mt>();
-        spdlog::sinks_init_list loggers{std::move(fileLoggerPtr), std::move(debugLoggerPtr)};
-        loggerPtr = std::make_shared<spdlog::logger>("log", loggers);
-    } else {
-        // If no debugger is attached, only log to the file.
-        loggerPtr = std::make_shared<spdlog::logger>("log", std::move(fileLoggerPtr));
-    }
+    std::vector<spdlog::sink_ptr> sinks{std::move(fileLoggerPtr)};
+    // If no debugger is attached, only log to the file.
+    if (IsDebuggerPresent()) sinks.push_back(std::make_shared<spdlog::sinks::msvc_sink_mt>());
+    spdlog::init_thread_pool(kLogQueueSize, 1);
+    auto loggerPtr = std::make_shared<spdlog::async_logger>("log", sinks.begin(), sinks.end(), spdlog::thread_pool(),
+                                                            spdlog::async_overflow_policy::overrun_oldest);
     spdlog::set_default_logger(std::move(loggerPtr));
-    spdlog::set_level(spdlog::level::trace);
-    spdlog::flush_on(spdlog::level::trace);
+    // Until the INI is read, SetLogLevel() applies the configured level
+    spdlog::set_level(spdlog::level::info);
+    spdlog::flush_on(spdlog::level::warn);
+    spdlog::flush_every(kLogFlushInterval);
 }
 
+// Messages below `level` are dropped before they are formatted
+void SetLogLevel(spdlog::level::level_enum level) { spdlog::set_level(level); }
+
+#endif
+
 // Then just call SetupLog() in your SKSE plugin initialization
 //
 // ^---- don't forget to do this or your logs won't work :)
\ No newline at end of file
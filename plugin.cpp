@@ -1,10 +1,31 @@
-#include <cstdint>  // For fixed-width integer types
-#include <map>      // For std::map
-#include <set>      // For std::set
-#include <string>   // For std::string
-#include <vector>   // For std::vector
+#include <algorithm>  // For std::sort, std::binary_search
+#include <atomic>     // For std::atomic
+#include <chrono>     // For std::chrono::steady_clock
+#include <cstdint>    // For fixed-width integer types
+#include <deque>      // For std::deque
+#include <memory>     // For std::shared_ptr
+#include <mutex>      // For std::mutex
+#include <optional>   // For std::optional
+#include <string>     // For std::string
+#include <thread>     // For std::thread
+#include <utility>    // For std::exchange
+#include <vector>     // For std::vector
 
+#include "MantellaDialogueBacklog.h"
+#include "MantellaDialogueCompression.h"
+#include "MantellaDialogueFormat.h"
 #include "MantellaDialogueIniConfig.h"
+#include "MantellaDialogueJournal.h"
+#include "MantellaDialogueLine.h"
+#include "MantellaDialogueProfiler.h"
+#include "MantellaDialogueQueue.h"
+#include "MantellaDialogueRules.h"
+#include "MantellaDialogueSerialization.h"
+#include "MantellaDialogueSnapshot.h"
+#include "MantellaDialogueStats.h"
+#include "MantellaDialogueText.h"
+#include "MantellaHttpChannel.h"
+#include "MantellaNamePool.h"
 #include "MantellaPapyrusInterface.h"
 #include "PCH.h"
 #include "json.h"  // Include nlohmann/json library
@@ -16,43 +37,7 @@ int port;
 
 namespace Hooks {
 
-    // -------------------------------------------------------------------------
-    // A small POD struct to store a single exchange: player's line, NPC's line,
-    // and the Skyrim in-game time at which it was recorded.
-    // -------------------------------------------------------------------------
-    struct DialogueLine {
-        std::string playerLine;
-        std::string playerName;
-        std::string npcLine;
-        std::string npcName;
-        float gameTimeHours;
-    };
-
-    inline void to_json(json& j, const DialogueLine& line) {
-        j = json{{"playerName", line.playerName},
-                 {"playerQuery", line.playerLine},
-                 {"npcName", line.npcName},
-                 {"npcResponse", line.npcLine},
-                 {"gameTimeHours", line.gameTimeHours}};
-    }
-
-    inline void from_json(const json& j, DialogueLine& line) {
-        j.at("playerName").get_to(line.playerName);
-        j.at("playerQuery").get_to(line.playerLine);
-        j.at("npcName").get_to(line.npcName);
-        j.at("npcResponse").get_to(line.npcLine);
-        j.at("gameTimeHours").get_to(line.gameTimeHours);
-    }
-
-
-    bool IsGreeting(std::string msg) {
-        std::string greetings[] = {"Hello", "CYRGenericHello", "DialogueGenericHello"};
-        for (std::string greeting : greetings)
-            if (msg == greeting) return true;
-        return false;
-    }
-
-    static bool IsEnabled() { return MantellaPapyrusInterface::GetMantellaEnableVanillaDialogueAwareness(); }
+    static bool IsEnabled() { return MantellaPapyrusInterface::GetMcmSettings()->enableVanillaDialogueAwareness; }
 
     // -------------------------------------------------------------------------
     // A simple helper to fetch current game time in hours.
@@ -66,17 +51,28 @@ namespace Hooks {
     // MantellaDialogueTracker:
     // - holds the participants list form
     // - tracks if there's an internal error
-    // - stores unsent dialogue lines in a map keyed by Actor form ID
+    // - stores unsent dialogue lines in a backlog keyed by Actor form ID
     // -------------------------------------------------------------------------
     struct MantellaDialogueTracker {
         static inline RE::BGSListForm* aParticipants;
         static inline bool DialogueTrackerHasError = false;
 
-        // Key = actor form ID, value = list of dialogue lines not yet added to Mantella
-        static inline std::map<RE::FormID, std::vector<DialogueLine>> s_dialogueHistory{};
+        // Dialogue lines not yet added to Mantella, per actor form ID. Guarded by s_dialogueHistoryLock,
+        // the hook writes it on the main thread while Papyrus-bound functions drain it on the VM thread.
+        static inline MantellaDialogueBacklog::DialogueBacklog s_dialogueHistory{};
+        static inline std::mutex s_dialogueHistoryLock;
+
+        // Keeps s_dialogueHistory encoded ahead of the next save. Never destroyed: joining its worker from a static
+        // destructor while the game process tears down would hang the exit.
+        static inline auto* s_snapshots =
+            new MantellaDialogueSnapshot::SnapshotEncoder(s_dialogueHistory, s_dialogueHistoryLock);
 
-        // We use std::set instead of std::unordered_set
-        static inline std::set<RE::FormID> s_lastParticipants{};
+        // Current conversation participants, sorted by FormID. Kept up to date by the Papyrus notify* functions and
+        // published copy-on-write, so the subtitle hook answers membership questions without walking the form list.
+        using ParticipantList = std::vector<RE::FormID>;
+        static inline std::atomic<std::shared_ptr<const ParticipantList>> s_participants{
+            std::make_shared<const ParticipantList>()};
+        static inline std::mutex s_participantsWriteLock;
 
         static void Setup() {
             auto dataHandler = RE::TESDataHandler::GetSingleton();
@@ -93,84 +89,387 @@ namespace Hooks {
             }
         }
 
+        // ---------------------------------------------------------------------
+        // Participant index maintenance. Writers copy the current list, modify
+        // the copy and swap it in; readers only ever do one atomic load.
+        // ---------------------------------------------------------------------
+        template <class Modify>
+        static void UpdateParticipants(Modify&& modify) {
+            std::scoped_lock lock(s_participantsWriteLock);
+            auto participants = std::make_shared<ParticipantList>(*s_participants.load(std::memory_order_acquire));
+            modify(*participants);
+            std::sort(participants->begin(), participants->end());
+            participants->erase(std::unique(participants->begin(), participants->end()), participants->end());
+            s_participants.store(std::move(participants), std::memory_order_release);
+        }
+
+        // Re-reads the whole participants form list. Only done on conversation start and game load.
+        static void RebuildParticipantIndex() {
+            ParticipantList formList;
+            if (aParticipants && aParticipants->scriptAddedTempForms)
+                formList.assign(aParticipants->scriptAddedTempForms->begin(),
+                                aParticipants->scriptAddedTempForms->end());
+            UpdateParticipants([&](ParticipantList& participants) { participants = std::move(formList); });
+        }
+
+        static void AddParticipants(const ParticipantList& added) {
+            UpdateParticipants([&](ParticipantList& participants) {
+                participants.insert(participants.end(), added.begin(), added.end());
+            });
+        }
+
+        static void RemoveParticipants(const ParticipantList& removed) {
+            UpdateParticipants([&](ParticipantList& participants) {
+                std::erase_if(participants, [&](RE::FormID formID) {
+                    return std::find(removed.begin(), removed.end(), formID) != removed.end();
+                });
+            });
+        }
+
+        static void ClearParticipants() {
+            UpdateParticipants([](ParticipantList& participants) { participants.clear(); });
+        }
+
+        // Debug builds only: makes sure the index did not drift away from Mantella's form list. Copies and sorts
+        // the form list, so it is run from the notify* functions, not per subtitle.
+        static void VerifyParticipantIndex() {
+#ifndef NDEBUG
+            const auto participants = s_participants.load(std::memory_order_acquire);
+            ParticipantList formList;
+            if (aParticipants && aParticipants->scriptAddedTempForms)
+                formList.assign(aParticipants->scriptAddedTempForms->begin(),
+                                aParticipants->scriptAddedTempForms->end());
+            std::sort(formList.begin(), formList.end());
+            formList.erase(std::unique(formList.begin(), formList.end()), formList.end());
+            if (formList != *participants)
+                logger::warn("Participant index out of sync: {} indexed, {} in the form list", participants->size(),
+                             formList.size());
+#endif
+        }
+
         // ---------------------------------------------------------------------
         // Helper: check if the conversation is considered "running" by looking
-        // at the participants list.
+        // at the participants index.
         // ---------------------------------------------------------------------
         static bool IsConversationRunning() {
             if (!aParticipants || DialogueTrackerHasError) return false;
-            auto scriptAddedForms = aParticipants->scriptAddedTempForms;
-            if (!scriptAddedForms) return false;
-            return !scriptAddedForms->empty();
+            return !s_participants.load(std::memory_order_acquire)->empty();
         }
 
         // ---------------------------------------------------------------------
-        // Helper: checks if a given actor is listed in the current participants form list.
+        // Helper: checks if a given actor is in the current participants index.
         // ---------------------------------------------------------------------
         static bool IsActorInConversation(RE::Actor* a_actor) {
             if (!a_actor || !aParticipants || DialogueTrackerHasError) return false;
-            auto formID = a_actor->GetFormID();
-            auto scriptAddedForms = aParticipants->scriptAddedTempForms;
-            if (!scriptAddedForms) return false;
-            for (auto& actorInConvFormId : *scriptAddedForms)
-                if (actorInConvFormId == formID) return true;
-            return false;
+            const auto participants = s_participants.load(std::memory_order_acquire);
+            return std::binary_search(participants->begin(), participants->end(), a_actor->GetFormID());
         }
 
         // ---------------------------------------------------------------------
-        // Called when a conversation starts.
+        // Called when a conversation starts, once the participant index has
+        // been rebuilt. The participants' old lines are replayed over the next
+        // frames by the ReplayQueue.
         // ---------------------------------------------------------------------
-        static void OnConversationStarted() {
-            if (DialogueTrackerHasError || !aParticipants) return;
-            // Clear previous participants
-            s_lastParticipants.clear();
-            // For each form in the participants, replay old lines if any
-            auto scriptAddedForms = aParticipants->scriptAddedTempForms;
-            if (!scriptAddedForms) return;
-            for (auto& formID : *scriptAddedForms) {
-                s_lastParticipants.insert(formID);
-                // See if we have stored lines for this participant
-                auto it = s_dialogueHistory.find(formID);
-                if (it == s_dialogueHistory.end()) continue;
-                SendAndDiscardCapturedDialogue(it);
-            }
-        }
-
-        // Sends the dialogue that was captured when not in a conversation to Mantella and removes it from the backlog
-        static void SendAndDiscardCapturedDialogue(
-            std::map<RE::FormID, std::vector<DialogueLine>>::iterator dialogueLineIterator) {
-            if (dialogueLineIterator == s_dialogueHistory.end()) {
-                logger::warn("SendAndDiscardCapturedDialogue: Invalid iterator provided.");
-                return;
+        static void OnConversationStarted();
+
+        // Stores an exchange until the actor joins a Mantella conversation
+        static void StoreForLater(RE::FormID formID, const DialogueLine& exchange) {
+            {
+                std::scoped_lock lock(s_dialogueHistoryLock);
+                if (s_dialogueHistory.Push(formID, exchange))
+                    logger::debug("  -> Backlog for {:X} is full, evicted its oldest line", formID);
             }
-            // Log the NPC name if available
-            if (!dialogueLineIterator->second.empty())
-                logger::debug("SendAndDiscardCapturedDialogue: Sending dialogue for NPC '%s'",
-                              dialogueLineIterator->second.front().npcName.c_str());
-            // Concatenate all lines into a single string
+            MantellaDialogueStats::RecordStored();
+            s_snapshots->NotifyChanged();
+        }
+
+        // Formats the dialogue that was captured when not in a conversation into one Mantella event and removes it
+        // from the backlog. With a ReplayBudgetChars only the top of the backlog is taken, the rest stays for the
+        // next conversation. Empty if there was nothing captured.
+        static std::string TakeCapturedDialogue(RE::FormID formID) {
+            // Format straight from the backlog's arena into one pre-sized string, then drop the sent lines
             std::string concatenatedLines;
-            for (auto& line : dialogueLineIterator->second)
-                concatenatedLines +=
-                    line.playerName + ": " + line.playerLine + ";\n " + line.npcName + ": " + line.npcLine + " ";
-            // Remove the trailing space, if any
-            if (!concatenatedLines.empty() && concatenatedLines.back() == ' ') concatenatedLines.pop_back();
-            // Send a single Mantella event with the concatenated lines
-            if (!concatenatedLines.empty()) MantellaPapyrusInterface::AddMantellaEvent(concatenatedLines.c_str());
-            // Erase the processed entry from dialogue history
-            s_dialogueHistory.erase(dialogueLineIterator);
-            logger::debug("Actor had captured dialogue. Sent it to mantella");
-            logger::info("SendAndDiscardCapturedDialogue: Removed processed dialogue from history.");
+            std::size_t linesLeft = 0;
+            {
+                std::scoped_lock lock(s_dialogueHistoryLock);
+                auto capturedLines = s_dialogueHistory.Find(formID);
+                if (!capturedLines) return {};
+                logger::debug("TakeCapturedDialogue: Sending dialogue for NPC '{}'",
+                              MantellaNamePool::Get(capturedLines->Oldest().npcName));
+                const auto budget =
+                    static_cast<std::size_t>(MantellaDialogueIniConfig::current()->ReplayBudgetChars);
+                if (budget == 0) {
+                    concatenatedLines = MantellaDialogueFormat::FormatReplay(*capturedLines);
+                    s_dialogueHistory.Erase(formID);
+                } else {
+                    const auto choices = MantellaDialogueFormat::SelectReplay(*capturedLines, budget);
+                    concatenatedLines = MantellaDialogueFormat::FormatReplay(*capturedLines, choices);
+                    linesLeft = s_dialogueHistory.RemoveLines(formID, [&](std::size_t index, const auto&) {
+                        return choices[index] != MantellaDialogueFormat::ReplayChoice::Keep;
+                    });
+                }
+            }
+            s_snapshots->NotifyChanged();
+            MantellaDialogueStats::RecordReplay(concatenatedLines.size());
+            if (linesLeft > 0)
+                logger::info("TakeCapturedDialogue: Took {} chars, kept {} lines over the replay budget.",
+                             concatenatedLines.size(), linesLeft);
+            else
+                logger::info("TakeCapturedDialogue: Removed processed dialogue from history.");
+            return concatenatedLines;
         }
 
         // ---------------------------------------------------------------------
-        // Called if a new participant joins mid-conversation.
+        // Called if new participants join mid-conversation.
         // ---------------------------------------------------------------------
-        static void OnNewParticipant(RE::Actor* a_newActor) {
-            if (!a_newActor || DialogueTrackerHasError) return;
-            auto newFormID = a_newActor->GetFormID();
-            auto it = s_dialogueHistory.find(newFormID);
-            if (it == s_dialogueHistory.end()) return;
-            SendAndDiscardCapturedDialogue(it);
+        static void OnNewParticipants(const ParticipantList& added);
+    };
+
+    // -------------------------------------------------------------------------
+    // MantellaEvents:
+    // Where events for Mantella go. With EnableHttpSideChannel and an HttpPort
+    // from the MCM they are POSTed to the Mantella server by an HttpChannel
+    // worker. Otherwise, and whenever the channel can't take or deliver a
+    // batch, they are dispatched to the Papyrus scripts as before.
+    // -------------------------------------------------------------------------
+    struct MantellaEvents {
+        static void Add(std::vector<std::string> events, bool deduplicate = true) {
+            if (deduplicate)
+                std::erase_if(events,
+                              [](const std::string& msg) { return MantellaPapyrusInterface::IsDuplicateEvent(msg); });
+            if (events.empty()) return;
+            std::size_t bytes = 0;
+            for (const auto& event : events) bytes += event.size();
+            MantellaDialogueStats::RecordSent(events.size(), bytes);
+            const auto config = MantellaDialogueIniConfig::current();
+            const int port = MantellaPapyrusInterface::GetMcmSettings()->httpPort;
+            if (config->EnableHttpSideChannel && port > 0 && s_http->Post(port, config->HttpSideChannelPath, events))
+                return;
+            MantellaPapyrusInterface::AddMantellaEvents(std::move(events), false);
+        }
+
+    private:
+        // Runs on the channel's worker, the Papyrus dispatch is done on the main thread like all the others
+        static void OnPostFailed(std::vector<std::string> events) {
+            auto taskInterface = SKSE::GetTaskInterface();
+            if (!taskInterface) {
+                logger::error("!!! MantellaEvents: Task interface is null, dropped {} events", events.size());
+                return;
+            }
+            taskInterface->AddTask([events = std::move(events)]() mutable {
+                MantellaPapyrusInterface::AddMantellaEvents(std::move(events), false);
+            });
+        }
+
+        // Never destroyed, like the snapshot encoder: joining its worker during process exit could hang
+        static inline auto* s_http = new MantellaHttpChannel::HttpChannel(OnPostFailed);
+    };
+
+    // -------------------------------------------------------------------------
+    // ReplayQueue:
+    // - conversation start and new participants only queue actors here, so
+    //   the Papyrus-bound notify* functions return right away
+    // - a task queued through SKSE's task interface takes one actor's
+    //   backlog after the other until kBytesPerFrame are collected (always at
+    //   least one actor per frame), sends them all in one Papyrus call and
+    //   leaves the rest for the next frame
+    // - an actor already waiting is not queued twice, and one that left the
+    //   conversation before its turn keeps its lines in the backlog
+    // -------------------------------------------------------------------------
+    struct ReplayQueue {
+        static constexpr std::size_t kBytesPerFrame = 16 * 1024;
+
+        static void Enqueue(const MantellaDialogueTracker::ParticipantList& formIDs) {
+            {
+                std::scoped_lock lock(s_lock);
+                for (auto formID : formIDs)
+                    if (std::find(s_pending.begin(), s_pending.end(), formID) == s_pending.end())
+                        s_pending.push_back(formID);
+                if (s_pending.empty() || s_scheduled) return;
+                s_scheduled = true;
+            }
+            Schedule();
+        }
+
+    private:
+        static void Schedule() {
+            auto taskInterface = SKSE::GetTaskInterface();
+            if (!taskInterface) {
+                logger::error("!!! ReplayQueue: Task interface is null, replaying inline");
+                Step();
+                return;
+            }
+            taskInterface->AddTask([]() { Step(); });
+        }
+
+        static void Step() {
+            std::vector<std::string> events;
+            std::size_t bytes = 0;
+            bool done = false;
+            while (bytes < kBytesPerFrame) {
+                RE::FormID formID;
+                {
+                    std::scoped_lock lock(s_lock);
+                    if (s_pending.empty()) {
+                        s_scheduled = false;
+                        done = true;
+                        break;
+                    }
+                    formID = s_pending.front();
+                    s_pending.pop_front();
+                }
+                const auto participants = MantellaDialogueTracker::s_participants.load(std::memory_order_acquire);
+                if (!std::binary_search(participants->begin(), participants->end(), formID)) continue;
+                auto event = MantellaDialogueTracker::TakeCapturedDialogue(formID);
+                if (event.empty()) continue;
+                bytes += event.size();
+                events.push_back(std::move(event));
+            }
+            if (!events.empty()) {
+                logger::debug("ReplayQueue: Sending the captured dialogue of {} actors", events.size());
+                MantellaEvents::Add(std::move(events));
+            }
+            if (done) return;
+            {
+                std::scoped_lock lock(s_lock);
+                if (s_pending.empty()) {
+                    s_scheduled = false;
+                    return;
+                }
+            }
+            Schedule();
+        }
+
+        static inline std::mutex s_lock;
+        static inline std::deque<RE::FormID> s_pending;  // guarded by s_lock
+        static inline bool s_scheduled = false;          // guarded by s_lock
+    };
+
+    void MantellaDialogueTracker::OnConversationStarted() {
+        if (DialogueTrackerHasError || !aParticipants) return;
+        // For each participant, replay old lines if any
+        ReplayQueue::Enqueue(*s_participants.load(std::memory_order_acquire));
+    }
+
+    void MantellaDialogueTracker::OnNewParticipants(const ParticipantList& added) {
+        if (DialogueTrackerHasError) return;
+        ReplayQueue::Enqueue(added);
+    }
+
+    // -------------------------------------------------------------------------
+    // DialogueDispatcher:
+    // - the ShowSubtitle hook only pushes exchanges into a lock-free ring
+    // - a drain task, queued through SKSE's task interface, runs at most once per
+    //   frame and merges everything pending into one call of MantellaEvents::Add
+    // - a batch is flushed early when it hits kMaxLinesPerBatch or kMaxBatchChars,
+    //   and the drain yields to the next frame once kDrainTimeBudget is used up
+    // -------------------------------------------------------------------------
+    struct DialogueDispatcher {
+        static constexpr std::size_t kQueueCapacity = 256;
+        static constexpr std::size_t kMaxLinesPerBatch = 16;
+        static constexpr std::size_t kMaxBatchChars = 8192;
+        static constexpr auto kDrainTimeBudget = std::chrono::microseconds(500);
+
+        static inline MantellaDialogueQueue::SpscRing<DialogueLine, kQueueCapacity> s_pending{};
+        static inline std::atomic<bool> s_drainScheduled = false;
+
+        static void Enqueue(DialogueLine&& exchange) {
+            if (!s_pending.TryPush(std::move(exchange))) {
+                // Ring is full (the drain did not get to run for a long time), don't lose the line.
+                logger::warn("DialogueDispatcher: Queue full, dispatching exchange synchronously");
+                MantellaEvents::Add({MantellaDialogueFormat::FormatExchange(exchange)});
+                return;
+            }
+            ScheduleDrain();
+        }
+
+        static void ScheduleDrain() {
+            if (s_drainScheduled.exchange(true, std::memory_order_acq_rel)) return;
+            auto taskInterface = SKSE::GetTaskInterface();
+            if (!taskInterface) {
+                logger::error("!!! DialogueDispatcher: Task interface is null, draining inline");
+                Drain();
+                return;
+            }
+            taskInterface->AddTask([]() { Drain(); });
+        }
+
+        static void Drain() {
+            const auto start = std::chrono::steady_clock::now();
+            std::vector<std::string> batches;
+            std::string batch;
+            std::size_t batchLines = 0;
+            DialogueLine exchange;
+            while (s_pending.TryPop(exchange)) {
+                // De-duplicate per exchange, a batch as a whole practically never repeats
+                const auto batchSize = batch.size();
+                if (batch.empty()) batch.reserve(kMaxBatchChars);
+                else batch.push_back('\n');
+                const auto exchangeStart = batch.size();
+                MantellaDialogueFormat::AppendExchange(batch, exchange, "; ");
+                if (MantellaPapyrusInterface::IsDuplicateEvent(std::string_view(batch).substr(exchangeStart))) {
+                    batch.resize(batchSize);
+                    continue;
+                }
+                if (++batchLines < kMaxLinesPerBatch && batch.size() < kMaxBatchChars) continue;
+                batches.push_back(std::move(batch));
+                batch.clear();
+                batchLines = 0;
+                if (std::chrono::steady_clock::now() - start >= kDrainTimeBudget) break;
+            }
+            if (!batch.empty()) batches.push_back(std::move(batch));
+            // Everything of this frame in one Papyrus call (or POST) where the scripts take a string[],
+            // otherwise one AddMantellaEvent per batch
+            if (!batches.empty()) MantellaEvents::Add(std::move(batches), false);
+            s_drainScheduled.store(false, std::memory_order_release);
+            // Either we ran out of time or the hook pushed while we were finishing up
+            if (!s_pending.Empty()) ScheduleDrain();
+        }
+    };
+
+    // -------------------------------------------------------------------------
+    // TraceCapture:
+    // With EnableTraceCapture the hook records every subtitle it processes,
+    // unfiltered, into <log folder>/MantellaDialogue.journal. The benchmarks
+    // replay it to reproduce what happened during a play session.
+    // -------------------------------------------------------------------------
+    struct TraceCapture {
+        static inline MantellaDialogueJournal::JournalWriter s_journal;
+        // Reused for every event, so its responses keep their capacity
+        static inline MantellaDialogueJournal::Event s_event;
+
+        static void Open() {
+            const auto& config = *MantellaDialogueIniConfig::current();
+            if (!config.EnableTraceCapture) return;
+            auto logsFolder = SKSE::log::log_directory();
+            if (!logsFolder) return;
+            const auto path = *logsFolder / "MantellaDialogue.journal";
+            if (s_journal.Open(path, static_cast<std::size_t>(config.TraceCaptureMaxMB) * 1024 * 1024))
+                logger::info("TraceCapture: Recording subtitles to {}", path.string());
+            else
+                logger::error("!!! TraceCapture: Failed to create {}", path.string());
+        }
+
+        static void Record(RE::TESObjectREFR* a_speaker, const char* a_subtitle,
+                           const RE::MenuTopicManager::Dialogue* dialogue) {
+            if (!s_journal.IsOpen()) return;
+            s_event.speakerFormID = a_speaker->GetFormID();
+            s_event.speakerName = a_speaker->GetDisplayFullName();
+            s_event.subtitle = a_subtitle ? a_subtitle : "";
+            s_event.topicText = dialogue->topicText.c_str();
+            s_event.topicInfoFlags = 0;
+            s_event.recordFlags = 0;
+            if (auto topicInfo = dialogue->parentTopicInfo) {
+                s_event.topicInfoFlags = static_cast<std::uint16_t>(topicInfo->data.flags.underlying());
+                s_event.recordFlags |= MantellaDialogueJournal::kHasTopicInfo;
+            }
+            s_event.gameTimeHours = GetCurrentGameTimeHours();
+            s_event.responses.clear();
+            for (auto* response : dialogue->responses)
+                if (response) s_event.responses.emplace_back(response->text.c_str());
+            if (!s_journal.Append(s_event))
+                logger::warn("TraceCapture: Journal reached TraceCaptureMaxMB, stopped after {} events.",
+                             s_journal.EventCount());
         }
     };
 
@@ -183,43 +482,44 @@ namespace Hooks {
         static bool HasAlreadyProcessed(std::string_view a_topicText) { return a_topicText == s_lastPlayerTopicText; }
 
         static void UpdateLastPlayerTopicText(std::string_view a_topicText) {
-            s_lastPlayerTopicText = std::string(a_topicText);
+            s_lastPlayerTopicText.assign(a_topicText);  // keeps its capacity
         }
 
-        static void AddDialogueExchangeAsync(const DialogueLine& exchange) {
-            MantellaPapyrusInterface::AddMantellaEvent(exchange.playerName + ": " + exchange.playerLine + "; " +
-                                                       exchange.npcName + ": " + exchange.npcLine);
+        static void AddDialogueExchangeAsync(DialogueLine exchange) {
+            DialogueDispatcher::Enqueue(std::move(exchange));
         }
 
-        static bool ShouldFilterDialoge(std::string playerLine, std::string npcLine, RE::TESTopicInfo* topicInfo) {
-            if (HasAlreadyProcessed(playerLine)) return true;
-            if (std::find(MantellaDialogueIniConfig::config.PlayerLineBlacklist.begin(),
-                          MantellaDialogueIniConfig::config.PlayerLineBlacklist.end(),
-                          playerLine) != MantellaDialogueIniConfig::config.PlayerLineBlacklist.end()) {
-                logger::debug(" -> Filtered: Player Line Blacklist");
-                return true;
-            }
-            if (std::find(MantellaDialogueIniConfig::config.NPCLineBlacklist.begin(),
-                          MantellaDialogueIniConfig::config.NPCLineBlacklist.end(),
-                          npcLine) != MantellaDialogueIniConfig::config.NPCLineBlacklist.end()) {
-                logger::debug(" -> Filtered: NPC Line Blacklist");
-                return true;
-            }
-            if (topicInfo != nullptr && MantellaDialogueIniConfig::config.FilterNonUniqueGreetings &&
-                IsGreeting(playerLine) && !(topicInfo->data.flags & RE::TOPIC_INFO_DATA::TOPIC_INFO_FLAGS::kSayOnce)) {
-                logger::debug(" -> Filtered: Greeting ");
-                return true;
+        // Verdicts per topic info, see MantellaDialogueRules::VerdictCache
+        static inline MantellaDialogueRules::VerdictCache s_verdicts;
+
+        // Runs the filter rules, or looks up what they said the last time this topic info came up
+        static MantellaDialogueRules::TopicVerdict Classify(const MantellaDialogueIniConfig::Configuration& config,
+                                                            std::string_view playerLine, std::string_view npcLine,
+                                                            RE::TESTopicInfo* topicInfo) {
+            if (!topicInfo) {
+                if (config.FilterNonUniqueGreetings && MantellaDialogueRules::IsGreeting(playerLine))
+                    logger::error(" -> Error: Topic Info is null");
+                return {MantellaDialogueRules::Classify(config, playerLine, npcLine, std::nullopt), 0};
             }
-            if (topicInfo == nullptr && MantellaDialogueIniConfig::config.FilterNonUniqueGreetings &&
-                IsGreeting(playerLine))
-                logger::error(" -> Error: Topic Info is null");
-            if (MantellaDialogueIniConfig::config.FilterShortReplies &&
-                MantellaDialogueIniConfig::split(npcLine, ' ').size() <
-                    MantellaDialogueIniConfig::config.FilterShortRepliesMinWordCount) {
-                logger::debug(" -> Filtered: Short reply");
+            if (auto cached = s_verdicts.Find(topicInfo->GetFormID(), playerLine, npcLine, config.generation))
+                return *cached;
+            const bool sayOnce = (topicInfo->data.flags & RE::TOPIC_INFO_DATA::TOPIC_INFO_FLAGS::kSayOnce) != 0;
+            const MantellaDialogueRules::TopicVerdict verdict{
+                MantellaDialogueRules::Classify(config, playerLine, npcLine, sayOnce), sayOnce ? kLineSayOnce : 0u};
+            s_verdicts.Store(topicInfo->GetFormID(), playerLine, npcLine, verdict);
+            return verdict;
+        }
+
+        static bool ShouldFilterDialoge(std::string_view playerLine,
+                                        const MantellaDialogueRules::TopicVerdict& verdict) {
+            if (HasAlreadyProcessed(playerLine)) {
+                MantellaDialogueStats::RecordRepeat();
                 return true;
             }
-            return false;
+            MantellaDialogueStats::RecordVerdict(verdict.reason);
+            if (verdict.reason == MantellaDialogueRules::FilterReason::None) return false;
+            logger::debug(" -> Filtered: {}", MantellaDialogueRules::Name(verdict.reason));
+            return true;
         }
 
         static RE::MenuTopicManager::Dialogue* GetDialogue() {
@@ -236,6 +536,7 @@ namespace Hooks {
         // The hook function
         static void thunk(RE::SubtitleManager* a_this, RE::TESObjectREFR* a_speaker, const char* a_subtitle,
                           bool a_alwaysDisplay) {
+            MANTELLA_PROFILE_START(profile);
             // Call original
             if (ShouldLogHookConfirmation == true) logger::info("Hooking into dialogue system...");
             func(a_this, a_speaker, a_subtitle, a_alwaysDisplay);
@@ -243,11 +544,13 @@ namespace Hooks {
                 logger::info(" -> Success");
                 ShouldLogHookConfirmation = false;
             }
+            MANTELLA_PROFILE_LAP(profile, Original);
 
             if (!IsEnabled()) {
                 logger::debug(" -> Mantella dialogue awareness is disabled.");
                 return;
             }
+            MANTELLA_PROFILE_LAP(profile, IsEnabled);
             if (!a_speaker) {
                 logger::error("!!! ShowSubtitle::thunk: a_speaker is null!");
                 return;
@@ -257,16 +560,28 @@ namespace Hooks {
                 logger::error("!!! ShowSubtitle::thunk: Cannot get dialogue!");
                 return;
             }
-            const std::string currentPlayerTopicText = dialogue->topicText.c_str();
+            TraceCapture::Record(a_speaker, a_subtitle, dialogue);
+            // Views into the game's strings, they stay valid for the whole call
+            const std::string_view currentPlayerTopicText = dialogue->topicText.c_str();
             if (currentPlayerTopicText.empty()) {
                 logger::warn("ShowSubtitle::thunk: currentPlayerTopicText is empty!");
                 return;
             }
-            // Build the NPC's response
-            std::string npcLine;
+            // Build the NPC's response into a buffer that keeps its capacity from one subtitle to the next
+            static thread_local std::string npcLineBuffer;
+            std::size_t npcLineSize = 0;
             for (auto* response : dialogue->responses)
-                if (response && !response->text.empty())
-                    npcLine += (npcLine.empty() ? "" : " ") + std::string(response->text.c_str());
+                if (response && !response->text.empty()) npcLineSize += response->text.size() + 1;
+            npcLineBuffer.clear();
+            npcLineBuffer.reserve(npcLineSize);
+            for (auto* response : dialogue->responses) {
+                if (!response || response->text.empty()) continue;
+                if (!npcLineBuffer.empty()) npcLineBuffer.push_back(' ');
+                npcLineBuffer.append(response->text.c_str(), response->text.size());
+            }
+            const std::string_view npcLine = npcLineBuffer;
+            MantellaDialogueStats::RecordSubtitle();
+            MANTELLA_PROFILE_LAP(profile, BuildLine);
             auto actor = skyrim_cast<RE::Actor*>(a_speaker);
             if (!actor) {
                 logger::error("!!! ShowSubtitle::thunk: a_speaker is empty or not an actor! Line to be spoken was: {}", npcLine);
@@ -277,48 +592,57 @@ namespace Hooks {
             const char* playerName = "Player";
             if (player && player->GetActorBase())
                 if (auto name = player->GetActorBase()->GetName(); name && name[0] != '\0') playerName = name;
-            auto exchange = DialogueLine();
-            exchange.playerLine = currentPlayerTopicText;
-            exchange.playerName = playerName;
-            exchange.npcLine = npcLine;
-            exchange.npcName = actor->GetDisplayFullName();
-            exchange.gameTimeHours = GetCurrentGameTimeHours();
-            if (std::find(MantellaDialogueIniConfig::config.NPCNamesToIgnore.begin(),
-                          MantellaDialogueIniConfig::config.NPCNamesToIgnore.end(),
-                          exchange.npcName) != MantellaDialogueIniConfig::config.NPCNamesToIgnore.end()) {
-                logger::debug(" -> Ignored NPC from Ignorelist: {}", exchange.npcName);
+            const std::string_view npcName = actor->GetDisplayFullName();
+            // One configuration for the whole subtitle, even if the INI is reloaded meanwhile
+            const auto config = MantellaDialogueIniConfig::current();
+            if (config->NPCNameFilter.Matches(npcName)) {
+                MantellaDialogueStats::RecordIgnoredNpc();
+                logger::debug(" -> Ignored NPC from Ignorelist: {}", npcName);
                 return;
             }
+            const auto verdict = Classify(*config, currentPlayerTopicText, npcLine, dialogue->parentTopicInfo);
             bool conversationRunning = MantellaDialogueTracker::IsConversationRunning();
             bool actorInConversation = MantellaDialogueTracker::IsActorInConversation(actor);
 
-            logger::info("({}): {}", exchange.playerName, exchange.playerLine);
-            logger::info("({}): {}", exchange.npcName, exchange.npcLine);
+            logger::info("({}): {}", playerName, currentPlayerTopicText);
+            logger::info("({}): {}", npcName, npcLine);
 
-            if (ShouldFilterDialoge(currentPlayerTopicText, npcLine, dialogue->parentTopicInfo)) return;
+            // The lap comes first, most subtitles are filtered and they belong in the Filter percentiles too
+            const bool filtered = ShouldFilterDialoge(currentPlayerTopicText, verdict);
+            MANTELLA_PROFILE_LAP(profile, Filter);
+            if (filtered) return;
+
+            // Only now that it is kept are the lines copied out of the game's strings and the buffer
+            auto exchange = DialogueLine();
+            exchange.playerLine.assign(currentPlayerTopicText);
+            exchange.playerName = MantellaNamePool::Intern(playerName);
+            exchange.npcLine.assign(npcLine);
+            exchange.npcName = MantellaNamePool::Intern(npcName);
+            exchange.gameTimeHours = GetCurrentGameTimeHours();
+            exchange.flags |= verdict.lineFlags;
 
             if (!conversationRunning) {
                 if (!MantellaDialogueTracker::DialogueTrackerHasError) {
-                    auto formID = actor->GetFormID();
-                    MantellaDialogueTracker::s_dialogueHistory[formID].push_back(exchange);
+                    MantellaDialogueTracker::StoreForLater(actor->GetFormID(), exchange);
                     logger::info("  -> Not in a conv: Stored dialogue line for later use");
                 } else
                     logger::debug(" -> Dialogue tracker is in error state :( cannot save the exchagne");
             } else {
                 if (actorInConversation) {
-                    AddDialogueExchangeAsync(exchange);
+                    AddDialogueExchangeAsync(std::move(exchange));
                     logger::info("  -> Sent dialogue to Mantella");
                 } else {
-                    AddDialogueExchangeAsync(exchange);
-                    logger::info("  -> Actor not in conversation, sent dialogue to Mantella anyways");
+                    // Stored first, so the exchange can be moved into the dispatcher afterwards
                     if (!MantellaDialogueTracker::DialogueTrackerHasError) {
-                        auto formID = actor->GetFormID();
-                        MantellaDialogueTracker::s_dialogueHistory[formID].push_back(exchange);
+                        MantellaDialogueTracker::StoreForLater(actor->GetFormID(), exchange);
                         logger::info("  -> Actor not in a conv: Stored dialogue line for later use");
                     }
+                    AddDialogueExchangeAsync(std::move(exchange));
+                    logger::info("  -> Actor not in conversation, sent dialogue to Mantella anyways");
                 }
             }
             UpdateLastPlayerTopicText(currentPlayerTopicText);
+            MANTELLA_PROFILE_LAP(profile, Dispatch);
         }
 
         // Original function pointer
@@ -331,6 +655,8 @@ namespace Hooks {
             if (REL::Module::IsAE())
                 targets = std::array{std::make_pair(RELOCATION_ID(19521, 19521), 0x2B2),
                                      std::make_pair(RELOCATION_ID(37544, 37544), OFFSET(0x8C2, 0x8C2))};
+            // One allocation for all targets, every AllocTrampoline call reserves a new block
+            SKSE::AllocTrampoline(targets.size() * stl::kThunkCallSize);
             for (auto& [id, offset] : targets) {
                 REL::Relocation<std::uintptr_t> target(id, offset);
                 stl::write_thunk_call<ShowSubtitle>(target.address());
@@ -340,42 +666,135 @@ namespace Hooks {
 
 }  // namespace Hooks
 
+namespace Hooks {
+
+    // -------------------------------------------------------------------------
+    // DialogueExpiry:
+    // Drops captured lines older than DialogueExpiryHours of game time. A
+    // ticker thread starts a sweep every kSweepInterval. The sweep itself runs
+    // as SKSE tasks on the main thread, kActorsPerTask actors per frame, so it
+    // never holds the backlog lock for long.
+    // -------------------------------------------------------------------------
+    struct DialogueExpiry {
+        static constexpr auto kSweepInterval = std::chrono::seconds(30);
+        static constexpr std::size_t kActorsPerTask = 16;
+
+        // Runs even with expiry turned off, an INI reload can turn it on
+        static void Start() {
+            // Detached and never stopped, it only sleeps and queues tasks
+            std::thread([]() {
+                while (true) {
+                    std::this_thread::sleep_for(kSweepInterval);
+                    if (MantellaDialogueIniConfig::current()->DialogueExpiryHours <= 0) continue;
+                    if (!s_sweeping.exchange(true, std::memory_order_acq_rel)) Schedule(0);
+                }
+            }).detach();
+            if (const int expiryHours = MantellaDialogueIniConfig::current()->DialogueExpiryHours; expiryHours > 0)
+                logger::info("SKSEPluginLoad: Captured dialogue expires after {} in-game hours.", expiryHours);
+        }
+
+    private:
+        static void Schedule(RE::FormID from) {
+            auto taskInterface = SKSE::GetTaskInterface();
+            if (!taskInterface) {
+                s_sweeping = false;
+                return;
+            }
+            taskInterface->AddTask([from]() { Step(from); });
+        }
+
+        static void Step(RE::FormID from) {
+            const float now = GetCurrentGameTimeHours();
+            if (now <= 0.0f) {  // no game loaded
+                s_sweeping = false;
+                return;
+            }
+            const int expiryHours = MantellaDialogueIniConfig::current()->DialogueExpiryHours;
+            if (expiryHours <= 0) {  // turned off by a reload since the sweep started
+                s_sweeping = false;
+                return;
+            }
+            const float cutoff = now - static_cast<float>(expiryHours);
+            MantellaDialogueBacklog::DialogueBacklog::ExpiryProgress progress;
+            {
+                std::scoped_lock lock(MantellaDialogueTracker::s_dialogueHistoryLock);
+                progress = MantellaDialogueTracker::s_dialogueHistory.ExpireBefore(cutoff, from, kActorsPerTask);
+            }
+            if (progress.linesExpired > 0) {
+                s_sweepExpired += progress.linesExpired;
+                MantellaDialogueTracker::s_snapshots->NotifyChanged();
+            }
+            if (!progress.done) {
+                Schedule(progress.next);
+                return;
+            }
+            if (s_sweepExpired > 0) logger::info("DialogueExpiry: Dropped {} expired dialogue lines.", s_sweepExpired);
+            s_sweepExpired = 0;
+            s_sweeping = false;
+        }
+
+        static inline std::atomic<bool> s_sweeping = false;
+        static inline std::size_t s_sweepExpired = 0;  // main thread only
+    };
+
+    // -------------------------------------------------------------------------
+    // DialogueStatsLog:
+    // Writes MantellaDialogueStats::Summary to the log every
+    // StatsLogIntervalMinutes, with the rates since the previous one. The
+    // backlog is measured under its lock, which costs one pass over the actors.
+    // -------------------------------------------------------------------------
+    struct DialogueStatsLog {
+        static constexpr std::size_t kLargestActors = 10;
+        static constexpr auto kCheckInterval = std::chrono::seconds(30);
+
+        // Runs even with the log turned off, an INI reload can turn it on
+        static void Start() {
+            // Detached and never stopped, like the expiry ticker
+            std::thread([]() {
+                auto previous = MantellaDialogueStats::Take();
+                while (true) {
+                    std::this_thread::sleep_for(kCheckInterval);
+                    const int minutes = MantellaDialogueIniConfig::current()->StatsLogIntervalMinutes;
+                    if (minutes <= 0 ||
+                        std::chrono::steady_clock::now() - previous.taken < std::chrono::minutes(minutes))
+                        continue;
+                    MantellaDialogueStats::BacklogUsage usage;
+                    {
+                        std::scoped_lock lock(MantellaDialogueTracker::s_dialogueHistoryLock);
+                        usage = MantellaDialogueStats::MeasureBacklog(MantellaDialogueTracker::s_dialogueHistory,
+                                                                      kLargestActors);
+                    }
+                    auto now = MantellaDialogueStats::Take();
+                    logger::info("DialogueStats: {}", MantellaDialogueStats::Summary(now, usage, &previous));
+                    previous = now;
+                }
+            }).detach();
+        }
+    };
+
+}  // namespace Hooks
+
 #pragma region Serialization
 // -----------------------------------------------------------------------------
-// JSON Serialization and Deserialization Functions
+// Co-save Serialization and Deserialization Functions
 // -----------------------------------------------------------------------------
+// Upper bound for all actors together (~6MB of data). Once crossed, the oldest lines are evicted on save.
 constexpr size_t MAX_DIALOGUE_LINES = 20000;
-std::string SerializeDialogueHistoryToJSON() {
-    size_t totalDialogueLines = 0;
-    for (const auto& [formID, dialogueLines] : Hooks::MantellaDialogueTracker::s_dialogueHistory) {
-        totalDialogueLines += dialogueLines.size();
-        if (totalDialogueLines > MAX_DIALOGUE_LINES) {
-            // Exceeded threshold: Discard all saved dialogue history, to avoid savegame bloat. The threshold is so high (~6MB of data)
-            // that this should never happen, but just to be safe.
-            logger::warn("!!! Exceeded max dialogue lines threshold: Discarding all saved dialogue history.");
-            return "{}";
-        }
-    }
-
-    json j;
-    for (const auto& [formID, dialogueLines] : Hooks::MantellaDialogueTracker::s_dialogueHistory) {
-        j[std::to_string(formID)] = dialogueLines;
-    }
-    return j.dump();
-}
 
+// Only used to migrate co-saves written before the binary 'HIS2' record
 bool DeserializeDialogueHistoryFromJSON(const std::string& jsonString) {
     try {
         json j = json::parse(jsonString);
-        Hooks::MantellaDialogueTracker::s_dialogueHistory.clear();
+        auto& history = Hooks::MantellaDialogueTracker::s_dialogueHistory;
+        std::scoped_lock lock(Hooks::MantellaDialogueTracker::s_dialogueHistoryLock);
+        history.Clear();
         for (auto it = j.begin(); it != j.end(); ++it) {
             RE::FormID formID = static_cast<RE::FormID>(std::stoul(it.key()));
             std::vector<Hooks::DialogueLine> dialogueLines = it.value().get<std::vector<Hooks::DialogueLine>>();
-            Hooks::MantellaDialogueTracker::s_dialogueHistory.emplace(formID, std::move(dialogueLines));
+            for (const auto& line : dialogueLines) history.Push(formID, line);
         }
-        logger::debug("Loaded {} actors with pending lines", Hooks::MantellaDialogueTracker::s_dialogueHistory.size());
-        logger::info("Deserialized dialogue history with %zu entries.",
-                     Hooks::MantellaDialogueTracker::s_dialogueHistory.size());
+        logger::debug("Loaded {} actors with pending lines", history.ActorCount());
+        logger::info("Deserialized dialogue history with {} entries.", history.LineCount());
         return true;
     } catch (const json::parse_error& e) {
         logger::error("!!! Failed to parse dialogue history JSON: %s", e.what());
@@ -386,27 +805,102 @@ bool DeserializeDialogueHistoryFromJSON(const std::string& jsonString) {
     }
 }
 
+bool LoadJsonHistoryRecord(SKSE::SerializationInterface* a_intfc) {
+    std::uint32_t jsonLength = 0;
+    if (a_intfc->ReadRecordData(&jsonLength, sizeof(jsonLength)) != sizeof(jsonLength)) {
+        logger::error("!!! MyLoadCallback: Failed to read JSON string length.");
+        return false;
+    }
+    std::string jsonString(jsonLength, '\0');
+    if (a_intfc->ReadRecordData(&jsonString[0], jsonLength) != jsonLength) {
+        logger::error("!!! MyLoadCallback: Failed to read JSON string data.");
+        return false;
+    }
+    return DeserializeDialogueHistoryFromJSON(jsonString);
+}
+
+bool LoadBinaryHistoryRecord(SKSE::SerializationInterface* a_intfc, std::uint32_t version, std::uint32_t length) {
+    if (version > MantellaDialogueSerialization::kHistoryRecordVersion) {
+        logger::error("!!! MyLoadCallback: 'HIS2' record version {} is newer than this plugin supports.", version);
+        return false;
+    }
+    std::string record(length, '\0');
+    if (a_intfc->ReadRecordData(record.data(), length) != length) {
+        logger::error("!!! MyLoadCallback: Failed to read 'HIS2' record data.");
+        return false;
+    }
+    std::string decompressed;
+    std::string_view payload = record;
+    if (version >= MantellaDialogueSerialization::kCompressedHistoryRecordVersion &&
+        !MantellaDialogueCompression::DecodeRecord(record, decompressed, payload)) {
+        logger::error("!!! MyLoadCallback: Failed to decompress the 'HIS2' record, discarding it.");
+        return false;
+    }
+    auto& history = Hooks::MantellaDialogueTracker::s_dialogueHistory;
+    std::scoped_lock lock(Hooks::MantellaDialogueTracker::s_dialogueHistoryLock);
+    if (!MantellaDialogueSerialization::ReadDialogueHistory(payload, history, version)) {
+        logger::error("!!! MyLoadCallback: 'HIS2' record is corrupted, discarding it.");
+        return false;
+    }
+    logger::info("MyLoadCallback: Deserialized dialogue history with {} lines of {} actors.", history.LineCount(),
+                 history.ActorCount());
+    return true;
+}
+
 constexpr std::uint32_t kSerializationID = 'MTDL';
 
 void MySaveCallback(SKSE::SerializationInterface* a_intfc) {
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = [start]() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    };
     try {
-        std::string jsonString = SerializeDialogueHistoryToJSON();
-        constexpr std::uint32_t recordType = 'HIST';
-        constexpr std::uint32_t version = 1;
-        if (!a_intfc->OpenRecord(recordType, version)) {
-            logger::error("!!! MySaveCallback: Failed to open 'HIST' record for serialization.");
+        auto& history = Hooks::MantellaDialogueTracker::s_dialogueHistory;
+        std::unique_lock lock(Hooks::MantellaDialogueTracker::s_dialogueHistoryLock);
+        if (auto evicted = history.TrimToTotal(MAX_DIALOGUE_LINES); evicted > 0)
+            logger::warn("MySaveCallback: Exceeded max dialogue lines threshold, evicted the {} oldest lines.",
+                         evicted);
+        const int compressionLevel =
+            MantellaDialogueIniConfig::historyCompressionLevel(*MantellaDialogueIniConfig::current());
+        if (!a_intfc->OpenRecord(MantellaDialogueSerialization::kHistoryRecord,
+                                 MantellaDialogueSerialization::kHistoryRecordVersion)) {
+            logger::error("!!! MySaveCallback: Failed to open 'HIS2' record for serialization.");
             return;
         }
-        std::uint32_t jsonLength = static_cast<std::uint32_t>(jsonString.size());
-        if (!a_intfc->WriteRecordData(&jsonLength, sizeof(jsonLength))) {
-            logger::error("!!! MySaveCallback: Failed to write JSON string length.");
+        // The background snapshot is used as long as nothing changed since it was taken, it only has to be copied
+        if (auto snapshot = Hooks::MantellaDialogueTracker::s_snapshots->Current();
+            snapshot && snapshot->version == history.Version() && snapshot->compressionLevel == compressionLevel) {
+            lock.unlock();
+            if (!MantellaDialogueSnapshot::WriteSnapshot(a_intfc, *snapshot)) {
+                logger::error("!!! MySaveCallback: Failed to write dialogue history record data.");
+                return;
+            }
+            logger::info("MySaveCallback: Serialized dialogue history to SKSE co-save ({} of {} bytes, from snapshot).",
+                         snapshot->RecordBytes(), snapshot->Bytes());
+            MantellaDialogueStats::RecordSave(elapsed(), snapshot->RecordBytes());
             return;
         }
-        if (!a_intfc->WriteRecordData(jsonString.c_str(), jsonLength)) {
-            logger::error("!!! MySaveCallback: Failed to write JSON string data.");
+        MantellaDialogueSerialization::WriteStats stats;
+        std::size_t recordBytes = 0;
+        bool written = false;
+        if (compressionLevel > 0) {
+            MantellaDialogueCompression::CompressingRecord compressor(a_intfc, compressionLevel);
+            written = MantellaDialogueSerialization::WriteDialogueHistory(&compressor, history, &stats) &&
+                      compressor.Finish();
+            recordBytes = compressor.BytesOut();
+        } else {
+            written = MantellaDialogueCompression::WriteUncompressedHeader(a_intfc) &&
+                      MantellaDialogueSerialization::WriteDialogueHistory(a_intfc, history, &stats);
+            recordBytes = 4 + stats.bytesWritten;
+        }
+        if (!written) {
+            logger::error("!!! MySaveCallback: Failed to write dialogue history record data.");
             return;
         }
-        logger::info("MySaveCallback: Serialized dialogue history to SKSE co-save.");
+        logger::info(
+            "MySaveCallback: Serialized dialogue history to SKSE co-save ({} of {} bytes, {} of {} actors changed).",
+            recordBytes, stats.bytesWritten, stats.actorsEncoded, history.ActorCount());
+        MantellaDialogueStats::RecordSave(elapsed(), recordBytes);
     } catch (const std::exception& e) {
         logger::error(" !!! MySaveCallback: Exception during serialization: %s", e.what());
     }
@@ -416,21 +910,19 @@ void MyLoadCallback(SKSE::SerializationInterface* a_intfc) {
     try {
         std::uint32_t type, version, length;
         while (a_intfc->GetNextRecordInfo(type, version, length)) {
-            if (type != 'HIST') continue;
-            std::uint32_t jsonLength = 0;
-            if (a_intfc->ReadRecordData(&jsonLength, sizeof(jsonLength)) != sizeof(jsonLength)) {
-                logger::error("!!! MyLoadCallback: Failed to read JSON string length.");
-                continue;
-            }
-            std::string jsonString(jsonLength, '\0');
-            if (a_intfc->ReadRecordData(&jsonString[0], jsonLength) != jsonLength) {
-                logger::error("!!! MyLoadCallback: Failed to read JSON string data.");
+            bool loaded = false;
+            if (type == MantellaDialogueSerialization::kJsonHistoryRecord)
+                loaded = LoadJsonHistoryRecord(a_intfc);
+            else if (type == MantellaDialogueSerialization::kHistoryRecord)
+                loaded = LoadBinaryHistoryRecord(a_intfc, version, length);
+            else
                 continue;
-            }
-            if (DeserializeDialogueHistoryFromJSON(jsonString))
+            if (loaded) {
                 logger::info("MyLoadCallback: Successfully loaded dialogue history from SKSE co-save.");
+                Hooks::MantellaDialogueTracker::s_snapshots->NotifyChanged();
+            }
             else
-                logger::error("!!! MyLoadCallback: Failed to deserialize dialogue history from JSON.");
+                logger::error("!!! MyLoadCallback: Failed to deserialize dialogue history.");
         }
     } catch (const std::exception& e) {
         logger::error("!!! MyLoadCallback: Exception during deserialization: %s", e.what());
@@ -438,7 +930,11 @@ void MyLoadCallback(SKSE::SerializationInterface* a_intfc) {
 }
 
 void MyRevertCallback(SKSE::SerializationInterface*) {
-    Hooks::MantellaDialogueTracker::s_dialogueHistory.clear();
+    {
+        std::scoped_lock lock(Hooks::MantellaDialogueTracker::s_dialogueHistoryLock);
+        Hooks::MantellaDialogueTracker::s_dialogueHistory.Clear();
+    }
+    MantellaPapyrusInterface::InvalidateScriptCache();
     logger::info("MyRevertCallback: Cleared dialogue history.");
 }
 #pragma endregion
@@ -447,8 +943,20 @@ void MyRevertCallback(SKSE::SerializationInterface*) {
 // SKSE Messaging Interface Listener
 // -----------------------------------------------------------------------------
 
+static void StartBackgroundWork();
+
 void OnSKSEMessage(SKSE::MessagingInterface::Message* a_msg) {
-    if (a_msg->type == SKSE::MessagingInterface::kDataLoaded) Hooks::MantellaDialogueTracker::Setup();
+    if (a_msg->type == SKSE::MessagingInterface::kDataLoaded) {
+        Hooks::MantellaDialogueTracker::Setup();
+        MantellaPapyrusInterface::ResolveScriptCache();
+        StartBackgroundWork();
+    }
+    if (a_msg->type == SKSE::MessagingInterface::kNewGame || a_msg->type == SKSE::MessagingInterface::kPreLoadGame)
+        MantellaPapyrusInterface::InvalidateScriptCache();
+    if (a_msg->type == SKSE::MessagingInterface::kNewGame || a_msg->type == SKSE::MessagingInterface::kPostLoadGame) {
+        MantellaPapyrusInterface::RefreshMcmSettings();
+        Hooks::MantellaDialogueTracker::RebuildParticipantIndex();
+    }
     if (a_msg->type == SKSE::MessagingInterface::kPostLoad) {
         auto serialization = SKSE::GetSerializationInterface();
         if (!serialization) {
@@ -472,30 +980,63 @@ void OnSKSEMessage(SKSE::MessagingInterface::Message* a_msg) {
 
 void notifyConversationStart(RE::StaticFunctionTag*) {
     logger::info("Conversation Started");
+    MantellaPapyrusInterface::RefreshMcmSettings();
+    // Indexed even while disabled, the feature can be turned on in the MCM mid-conversation
+    Hooks::MantellaDialogueTracker::RebuildParticipantIndex();
+    Hooks::MantellaDialogueTracker::VerifyParticipantIndex();
     if (!Hooks::IsEnabled()) return;
     Hooks::MantellaDialogueTracker::OnConversationStarted();
 }
 
-void notifyActorAdded(RE::StaticFunctionTag*, std::vector<RE::TESForm*> actors) {
-    // calll OnNewParticipant() for each actor
+// FormIDs of all actor forms in `actors`, logs and skips everything else
+static Hooks::MantellaDialogueTracker::ParticipantList GetActorFormIDs(const std::vector<RE::TESForm*>& actors,
+                                                                       const char* caller) {
+    Hooks::MantellaDialogueTracker::ParticipantList formIDs;
+    formIDs.reserve(actors.size());
     for (auto* actor : actors) {
-        auto actorForm = skyrim_cast<RE::Actor*>(actor);
-        if (!actorForm) {
-            logger::error("!!! notifyActorAdded: Actor is not an Actor form!");
+        if (!skyrim_cast<RE::Actor*>(actor)) {
+            logger::error("!!! {}: Actor is not an Actor form!", caller);
             continue;
         }
-        Hooks::MantellaDialogueTracker::OnNewParticipant(actorForm);
+        formIDs.push_back(actor->GetFormID());
     }
+    return formIDs;
+}
+
+void notifyActorAdded(RE::StaticFunctionTag*, std::vector<RE::TESForm*> actors) {
+    const auto added = GetActorFormIDs(actors, "notifyActorAdded");
+    Hooks::MantellaDialogueTracker::AddParticipants(added);
+    Hooks::MantellaDialogueTracker::VerifyParticipantIndex();
+    // Their old lines join the replays still queued from the conversation start
+    Hooks::MantellaDialogueTracker::OnNewParticipants(added);
 }
 
 void notifyActorRemoved(RE::StaticFunctionTag*, std::vector<RE::TESForm*> actors) {
     logger::debug("Actor left conversation");
+    Hooks::MantellaDialogueTracker::RemoveParticipants(GetActorFormIDs(actors, "notifyActorRemoved"));
+    Hooks::MantellaDialogueTracker::VerifyParticipantIndex();
+}
+
+// Called by the MCM whenever one of the settings we snapshot changes
+void notifySettingsChanged(RE::StaticFunctionTag*) {
+    logger::info("Settings Changed");
+    MantellaPapyrusInterface::RefreshMcmSettings();
 }
 
 void notifyConversationEnd(RE::StaticFunctionTag*) {
     logger::info("Conversation Ended");
-    if (!Hooks::IsEnabled()) return;
-    Hooks::MantellaDialogueTracker::s_lastParticipants.clear();
+    Hooks::MantellaDialogueTracker::ClearParticipants();
+}
+
+// One line of what the plugin did since the game started and what the stored dialogue takes up, for debugging
+std::string getDialogueStats(RE::StaticFunctionTag*) {
+    MantellaDialogueStats::BacklogUsage usage;
+    {
+        std::scoped_lock lock(Hooks::MantellaDialogueTracker::s_dialogueHistoryLock);
+        usage = MantellaDialogueStats::MeasureBacklog(Hooks::MantellaDialogueTracker::s_dialogueHistory,
+                                                      Hooks::DialogueStatsLog::kLargestActors);
+    }
+    return MantellaDialogueStats::Summary(MantellaDialogueStats::Take(), usage);
 }
 
 bool Bind(RE::BSScript::IVirtualMachine* vm) {
@@ -504,20 +1045,103 @@ bool Bind(RE::BSScript::IVirtualMachine* vm) {
     vm->RegisterFunction("notifyNpcAdded", classname, notifyActorAdded);
     vm->RegisterFunction("notifyNpcRemoved", classname, notifyActorRemoved);
     vm->RegisterFunction("notifyConversationEnd", classname, notifyConversationEnd);
+    vm->RegisterFunction("notifySettingsChanged", classname, notifySettingsChanged);
+    vm->RegisterFunction("getDialogueStats", classname, getDialogueStats);
     return true;
 }
 
+// Hot-path profiler: dumps into MantellaDialogue.log, and into a CSV next to it if requested
+static void ConfigureProfiler() {
+#if MANTELLA_ENABLE_PROFILING
+    const auto& config = *MantellaDialogueIniConfig::current();
+    std::filesystem::path csvPath;
+    if (auto logsFolder = SKSE::log::log_directory(); logsFolder && config.HotPathProfilingCsv)
+        csvPath = *logsFolder / "MantellaDialogueProfile.csv";
+    MantellaDialogueProfiler::Get().Configure(
+        config.EnableHotPathProfiling, std::chrono::seconds(config.HotPathProfilingIntervalSeconds), std::move(csvPath),
+        [](const std::string& line) { logger::info("{}", line); });
+    if (config.EnableHotPathProfiling)
+        logger::info("SKSEPluginLoad: Hot-path profiling enabled, dumping every {}s.",
+                     config.HotPathProfilingIntervalSeconds);
+#endif
+}
+
+// The settings that are copied out of the configuration into other parts of the plugin
+static void ApplyConfiguration(const MantellaDialogueIniConfig::Configuration& config) {
+    SetLogLevel(MantellaDialogueIniConfig::effectiveLogLevel(config));
+    {
+        std::scoped_lock lock(Hooks::MantellaDialogueTracker::s_dialogueHistoryLock);
+        Hooks::MantellaDialogueTracker::s_dialogueHistory.SetLinesPerActor(
+            static_cast<std::size_t>(config.MaxDialogueLinesPerActor));
+    }
+    Hooks::MantellaDialogueTracker::s_snapshots->SetCompressionLevel(
+        MantellaDialogueIniConfig::historyCompressionLevel(config));
+    // The dedup window is only used on the main thread
+    const auto dedupWindowSize = static_cast<std::size_t>(config.DedupWindowSize);
+    if (auto taskInterface = SKSE::GetTaskInterface())
+        taskInterface->AddTask([dedupWindowSize]() { MantellaPapyrusInterface::s_sentEvents.Resize(dedupWindowSize); });
+    else
+        MantellaPapyrusInterface::s_sentEvents.Resize(dedupWindowSize);
+}
+
+// Never destroyed, its thread runs until the game exits
+static auto* s_configWatcher = new MantellaDialogueIniConfig::ConfigWatcher();
+
+// Called on the watcher thread whenever MantellaDialogue.ini was saved
+static void OnConfigurationReloaded(std::shared_ptr<MantellaDialogueIniConfig::Configuration> reloaded) {
+    std::shared_ptr<const MantellaDialogueIniConfig::Configuration> config = reloaded;
+    MantellaDialogueIniConfig::publish(std::move(reloaded));
+    ApplyConfiguration(*config);
+    logger::info(
+        "ConfigWatcher: Reloaded MantellaDialogue.ini. Profiling and trace capture settings apply after a restart.");
+}
+
+// Threads and files nothing needs before the game data is loaded, kept out of the game's boot
+static void StartBackgroundWork() {
+    static bool started = false;
+    if (std::exchange(started, true)) return;
+    Hooks::TraceCapture::Open();
+    Hooks::MantellaDialogueTracker::s_snapshots->Start();
+    Hooks::DialogueExpiry::Start();
+    Hooks::DialogueStatsLog::Start();
+    if (s_configWatcher->Start(MantellaDialogueIniConfig::kDefaultPath, OnConfigurationReloaded))
+        logger::info("OnSKSEMessage: Watching MantellaDialogue.ini for changes.");
+    else
+        logger::warn("OnSKSEMessage: Can't watch MantellaDialogue.ini, changes apply after a restart.");
+}
+
 SKSEPluginLoad(const SKSE::LoadInterface* skse) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    auto last = start;
+    // Microseconds since the previous call
+    auto lap = [&last]() {
+        const auto now = Clock::now();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count();
+        last = now;
+        return elapsed;
+    };
+
     SKSE::Init(skse);
     SKSE::GetPapyrusInterface()->Register(Bind);
     SetupLog();
+    const auto initTime = lap();
     MantellaDialogueIniConfig::loadConfiguration();
+    ApplyConfiguration(*MantellaDialogueIniConfig::current());
+    ConfigureProfiler();
+    const auto configTime = lap();
     if (auto messaging = SKSE::GetMessagingInterface()) {
         messaging->RegisterListener("SKSE", OnSKSEMessage);
         logger::info("SKSEPluginLoad: Registered SKSE messaging listener.");
-    } else
+    } else {
         logger::error("!!! SKSEPluginLoad: Failed to get SKSE Messaging Interface!");
+        StartBackgroundWork();
+    }
     Hooks::ShowSubtitle::Install();
     logger::info("SKSEPluginLoad: Installed ShowSubtitle hook.");
+    const auto hookTime = lap();
+    logger::info("SKSEPluginLoad: Started in {}us (SKSE and log {}us, configuration {}us, hook {}us).",
+                 std::chrono::duration_cast<std::chrono::microseconds>(last - start).count(), initTime, configTime,
+                 hookTime);
     return true;
 }